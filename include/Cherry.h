@@ -22,6 +22,7 @@
 #include "material/diffuse.h"
 #include "material/microfacet.h"
 #include "material/reflect.h"
+#include "object/mesh.h"
 #include "object/primitive/cuboid.h"
 #include "object/primitive/sphere.h"
 #include "object/primitive/triangle.h"
@@ -11,33 +11,273 @@
 #ifndef CHERRY_ACCELERATION_BVH
 #define CHERRY_ACCELERATION_BVH
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "acceleration/bvh_builder.h"
+#include "acceleration/geometry_store.h"
+#include "acceleration/primitive_block.h"
+#include "acceleration/wide_bvh.h"
 #include "common/intersection.h"
 #include "common/ray.h"
+#include "common/ray_packet.h"
 #include "core/object.h"
+#include "utility/mapped_file.h"
 
 namespace cherry {
-struct BvhNode {
-  BvhNode() : left(nullptr), right(nullptr), object(nullptr) { bounds = Box(); }
-  std::shared_ptr<BvhNode> left;
-  std::shared_ptr<BvhNode> right;
-  std::shared_ptr<Object> object;
+
+/**
+ * @brief Node of the flattened hierarchy. Children always come after their
+ * parent. In depth-first order the first child directly follows it, and every
+ * subtree is a contiguous range of nodes.
+ */
+struct alignas(64) LinearBvhNode {
   Box bounds;
-  double area{};
+  union {
+    uint32_t primitives_offset;    // leaf
+    uint32_t second_child_offset;  // interior
+  };
+  uint16_t primitive_count;     // 0 for interior nodes
+  uint8_t axis;                 // split axis of interior nodes
+  uint32_t first_child_offset;  // interior
 };
+static_assert(sizeof(LinearBvhNode) == 64, "LinearBvhNode must fill a line");
+
+// depth of binary hierarchy the traversal stacks hold; the builders stay
+// within it
+constexpr int kMaxBvhDepth = 64;
+
+// node visitor of TraverseBinary that does nothing
+struct IgnoreNode {
+  void operator()(uint32_t /*index*/) const {}
+};
+
+/**
+ * @brief Depth-first walk of the binary nodes below root whose box ray hits.
+ * visit_leaf(node) tests a leaf and returns true to end the walk, it may
+ * shrink ray.t_max to cull farther nodes. visit_node(index) is called for
+ * every node whose box is tested.
+ *
+ * @param near_first visit the child nearer to the ray origin first
+ * @return whether visit_leaf ended the walk
+ */
+template <typename LeafVisitor, typename NodeVisitor = IgnoreNode>
+auto TraverseBinary(std::span<const LinearBvhNode> nodes, uint32_t root,
+                    const Ray &ray, bool near_first, LeafVisitor &&visit_leaf,
+                    NodeVisitor &&visit_node = {}) -> bool {
+  std::array<uint32_t, kMaxBvhDepth> stack{};
+  int stack_size = 0;
+  uint32_t current = root;
+  while (true) {
+    visit_node(current);
+    auto const &node = nodes[current];
+    if (node.bounds.IntersectP(ray)) {
+      if (node.primitive_count > 0) {
+        if (visit_leaf(node)) return true;
+      } else {
+        // the other child waits on the stack
+        auto const kFlip = near_first && ray.direction_inv[node.axis] < 0;
+        stack[stack_size++] =
+            kFlip ? node.first_child_offset : node.second_child_offset;
+        current = kFlip ? node.second_child_offset : node.first_child_offset;
+        continue;
+      }
+    }
+    if (stack_size == 0) return false;
+    current = stack[--stack_size];
+  }
+}
+
 class Bvh {
  public:
-  Bvh() : root_(nullptr) {}
-  void Construct(const std::vector<std::shared_ptr<Object>> &objects);
+  Bvh() = default;
+  /**
+   * @brief Build the hierarchy over objects, or map it from
+   * options.cache_file when that was written for the same objects and options
+   *
+   * @param profile_rays with BvhNodeOrder::kTreelets, rays whose node visits
+   * weight the treelets instead of surface areas
+   */
+  void Construct(const std::vector<std::shared_ptr<Object>> &objects,
+                 const BvhBuildOptions &options = {},
+                 std::span<const Ray> profile_rays = {});
+  // closest hit, with its attributes computed once it is known
   auto Intersect(const Ray &ray, Intersection &intersection) const -> bool;
-  [[nodiscard]] static auto Build(
-      const std::vector<std::shared_ptr<Object>> &objects)
-      -> std::shared_ptr<BvhNode>;
-  [[nodiscard]] static auto GetIntersection(const Ray &,
-                                            const std::shared_ptr<BvhNode> &,
-                                            Intersection &) -> bool;
+  // closest hit within the ray interval, recorded without its attributes
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool;
+  // returns as soon as any primitive is hit within the ray interval
+  [[nodiscard]] auto IntersectAny(const Ray &ray) const -> bool;
+  /**
+   * @brief Trace the rays of a packet together through the binary nodes. A
+   * node is fetched once for all rays and skipped for the whole packet when an
+   * interval test over the rays misses it. Packets whose direction signs
+   * differ, and packets on a wide layout, whose nodes already test several
+   * boxes at once, are traced ray by ray.
+   *
+   * @param intersections the closest hit of every lane that hit something
+   * @return bit mask of the lanes that hit something
+   */
+  auto Intersect(const RayPacket &packet,
+                 std::span<Intersection, kPacketSize> intersections) const
+      -> uint32_t;
+  // bit mask of the lanes that hit anything within their ray interval
+  [[nodiscard]] auto IntersectAny(const RayPacket &packet) const -> uint32_t;
+  /**
+   * @brief Register the materials of the primitives. A hierarchy shared by
+   * instances in several scenes holds the ids of the last scene bound.
+   */
+  void BindMaterials(MaterialTable &materials);
+  // bounds of everything in the hierarchy, empty before Construct
+  [[nodiscard]] auto Bounds() const -> Box {
+    return Nodes().empty() ? Box() : Nodes()[0].bounds;
+  }
+  [[nodiscard]] auto Options() const -> const BvhBuildOptions & {
+    return options_;
+  }
+  /**
+   * @brief Update the node bounds after primitives moved, keeping the
+   * topology. The subtree where the SAH cost grew past
+   * options.rebuild_threshold times its cost at build time is rebuilt; that
+   * is the whole tree when the degradation is spread over both root children.
+   *
+   * @param objects those of Construct, in the same order, copied over the
+   * primitives the hierarchy holds
+   */
+  void Refit(const std::vector<std::shared_ptr<Object>> &objects);
+  /**
+   * @brief SAH cost of the hierarchy, the expected cost of a ray that enters
+   * the root
+   */
+  [[nodiscard]] auto Cost() const -> double;
 
  private:
-  std::shared_ptr<BvhNode> root_;
+  // the nodes traversed: mapped from the cache file or built in memory
+  [[nodiscard]] auto Nodes() const -> std::span<LinearBvhNode const> {
+    return mapping_ ? mapped_nodes_ : std::span<LinearBvhNode const>(nodes_);
+  }
+  template <typename Node>
+  [[nodiscard]] auto WideNodes() const -> std::span<Node const> {
+    auto const &array = std::get<WideNodeArray<Node>>(wide_nodes_);
+    return mapping_ ? array.mapped : std::span<Node const>(array.nodes);
+  }
+  // calls visit with the node array of the wide layout, not at all for
+  // BvhLayout::kBinary
+  template <typename Self, typename Visitor>
+  static void VisitWideNodes(Self &self, Visitor &&visit) {
+    switch (self.options_.layout) {
+      case BvhLayout::kWide4:
+        visit(std::get<0>(self.wide_nodes_));
+        break;
+      case BvhLayout::kWide8:
+        visit(std::get<1>(self.wide_nodes_));
+        break;
+      case BvhLayout::kCompressed4:
+        visit(std::get<2>(self.wide_nodes_));
+        break;
+      case BvhLayout::kCompressed8:
+        visit(std::get<3>(self.wide_nodes_));
+        break;
+      default:
+        break;
+    }
+  }
+
+  // cache file (bvh_cache.cc)
+  static auto CacheKey(const std::vector<std::shared_ptr<Object>> &objects,
+                       const BvhBuildOptions &options) -> uint64_t;
+  // slots receives the object of each slot
+  auto LoadCache(const std::vector<std::shared_ptr<Object>> &objects,
+                 uint64_t key, std::vector<uint32_t> &slots) -> bool;
+  void SaveCache(std::span<BvhPrimitive const> references, uint64_t key) const;
+  // copies a mapped hierarchy into memory so that it can be modified
+  void Detach();
+
+  // node order (bvh_layout.cc)
+  void LayOutTreelets(const std::vector<double> &weights);
+  void RestoreDepthFirst();
+  // moves node order[i] to i
+  void PermuteNodes(const std::vector<uint32_t> &order);
+  // chance of visiting each node once the root is entered, by surface area
+  [[nodiscard]] auto AreaWeights() const -> std::vector<double>;
+  // nodes visited by the closest-hit traversal of rays
+  [[nodiscard]] auto CountVisits(std::span<const Ray> rays) const
+      -> std::vector<double>;
+
+  auto Flatten(const BvhBuildNode &node, uint32_t primitive_base,
+               uint32_t &offset) -> uint32_t;
+  // moves the objects into store_, slots holding the object of each slot,
+  // and lays out the leaves
+  void SetPrimitives(const std::vector<std::shared_ptr<Object>> &objects,
+                     std::span<const uint32_t> slots);
+  // sorts the leaves among the nodes [begin, end) by primitive kind
+  void SortLeaves(uint32_t begin, uint32_t end);
+  // closest hit in the leaf [offset, offset + count), narrowing ray.t_max
+  auto IntersectLeaf(uint32_t offset, uint32_t count, Ray &ray,
+                     HitRecord &record) const -> bool {
+    return blocks_.Intersect(store_, primitives_, offset, count, ray, record);
+  }
+  [[nodiscard]] auto IntersectLeafAny(uint32_t offset, uint32_t count,
+                                      const Ray &ray) const -> bool {
+    return blocks_.IntersectP(store_, primitives_, offset, count, ray);
+  }
+  void ComputeCosts(std::vector<double> &costs) const;
+  void RebuildSubtree(uint32_t index);
+  void CollapseLayout();
+  // edges from the root down to node index
+  [[nodiscard]] auto Depth(uint32_t index) const -> int;
+  // one past the last node of the subtree in the depth-first array
+  [[nodiscard]] auto SubtreeEnd(uint32_t index) const -> uint32_t;
+  [[nodiscard]] auto PrimitiveRange(uint32_t index) const
+      -> std::pair<uint32_t, uint32_t>;
+  // traverse the subtree under root only
+  auto IntersectBinary(const Ray &ray, HitRecord &record,
+                       uint32_t root = 0) const -> bool;
+  [[nodiscard]] auto IntersectAnyBinary(const Ray &ray, uint32_t root = 0) const
+      -> bool;
+
+  // wide layouts, collapsed from the binary nodes (wide_bvh.cc)
+  template <typename Node>
+  void Collapse(std::vector<Node> &wide) const;
+  template <typename Node>
+  auto CollapseNode(uint32_t index, std::vector<Node> &wide) const
+      -> uint32_t;
+  template <typename Node>
+  auto IntersectWide(std::span<Node const> wide, const Ray &ray,
+                     HitRecord &record) const -> bool;
+  template <typename Node>
+  auto IntersectAnyWide(std::span<Node const> wide, const Ray &ray) const
+      -> bool;
+
+  template <typename Node>
+  struct WideNodeArray {
+    std::vector<Node> nodes;
+    // into the cache file while it is mapped
+    std::span<Node const> mapped;
+  };
+
+  BvhBuildOptions options_;
+  std::vector<LinearBvhNode> nodes_;
+  // only the array of options_.layout is filled
+  std::tuple<WideNodeArray<WideBvhNode<4>>, WideNodeArray<WideBvhNode<8>>,
+             WideNodeArray<CompressedBvhNode<4>>,
+             WideNodeArray<CompressedBvhNode<8>>>
+      wide_nodes_;
+  // owns the primitives, one entry per object
+  GeometryStore store_;
+  // the entry of store_ each slot refers to
+  std::vector<PrimitiveRef> primitives_;
+  PrimitiveBlocks blocks_;
+  // per node SAH cost when its subtree was built, the refit baseline
+  std::vector<double> build_costs_;
+  // set while the nodes are read from the cache file, the vectors above are
+  // empty then
+  std::shared_ptr<MappedFile const> mapping_;
+  std::span<LinearBvhNode const> mapped_nodes_;
 };
 }  // namespace cherry
 
@@ -0,0 +1,231 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : bvh_builder.h
+// Author      : QRWells
+// Created at  : 2026/10/18 14:02
+// Description : Parallel binned-SAH builder producing the BVH build tree
+
+#ifndef CHERRY_ACCELERATION_BVH_BUILDER
+#define CHERRY_ACCELERATION_BVH_BUILDER
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/box.h"
+#include "math/vector.h"
+
+namespace cherry {
+/**
+ * @brief Reference to a primitive with its bounds and centroid precomputed
+ */
+struct BvhPrimitive {
+  Box bounds;
+  math::Point3 centroid;
+  uint32_t index{};
+};
+
+/**
+ * @brief Memory layout the hierarchy is traversed in
+ */
+enum class BvhLayout : uint8_t {
+  kBinary,  // LinearBvhNode, two children per node
+  kWide4,   // collapsed to four children per node
+  kWide8,   // collapsed to eight children per node
+  // as kWide4 / kWide8 with child bounds quantized to 8 bits, a quarter of the
+  // binary node size per child
+  kCompressed4,
+  kCompressed8,
+};
+
+/**
+ * @brief Trade-off between build time and traversal cost
+ */
+enum class BvhBuildQuality : uint8_t {
+  kPreview,  // LBVH emitted from radix-sorted Morton codes
+  kFast,     // binned SAH over primitive centroids
+  kHigh,     // additionally splits straddling references in space (SBVH)
+};
+
+/**
+ * @brief Order of the binary nodes in memory, traversal results are the same
+ */
+enum class BvhNodeOrder : uint8_t {
+  kDepthFirst,  // the first child right behind its parent
+  // page-sized treelets, each filled with the nodes of a subtree that are the
+  // most likely to be visited
+  kTreelets,
+};
+
+/**
+ * @brief Parameters of the SAH cost model, leaf creation and node layout
+ */
+struct BvhBuildOptions {
+  // leaves never hold more primitives than this, clamped to kMaxLeafSize
+  uint32_t max_leaf_size = 4;
+  // cost of visiting an interior node relative to the primitive tests
+  double traversal_cost = 0.125;
+  // cost of testing a single primitive
+  double intersection_cost = 1.0;
+  // primitives a leaf tests together at the cost of one, as SIMD kernels do,
+  // so leaves are charged per started batch
+  uint32_t leaf_batch_size = 1;
+  BvhLayout layout = BvhLayout::kBinary;
+  BvhBuildQuality quality = BvhBuildQuality::kFast;
+  // references spatial splits may add, as a fraction of the primitive count
+  double split_budget = 0.5;
+  // preview builds: rebuild the levels above the Morton treelets with SAH
+  bool lbvh_sah_treelets = true;
+  BvhNodeOrder node_order = BvhNodeOrder::kDepthFirst;
+  // camera rays Scene::BuildBvh traces to weight the treelets by the node
+  // visits they make; with 0 the visits are estimated from surface areas
+  uint32_t treelet_profile_rays = 0;
+  // Bvh::Refit rebuilds a subtree once its SAH cost exceeds this multiple of
+  // the cost it had when it was built
+  double rebuild_threshold = 1.5;
+  // Bvh::Construct maps the hierarchy from this file when it was cached for
+  // the same primitives and options, and writes it there otherwise. Empty
+  // disables the cache.
+  std::filesystem::path cache_file;
+
+  static constexpr uint32_t kMaxLeafSize = 255;
+
+  friend auto operator==(BvhBuildOptions const&, BvhBuildOptions const&)
+      -> bool = default;
+};
+
+/**
+ * @brief Bounds of the part of primitive index that lies inside clip
+ */
+using BvhClipFunction = std::function<Box(uint32_t index, Box const& clip)>;
+
+/**
+ * @brief Node of the build tree. Leaves cover the contiguous range
+ * [first_primitive, first_primitive + primitive_count) of the reordered
+ * reference array.
+ */
+struct BvhBuildNode {
+  Box bounds;
+  std::array<std::unique_ptr<BvhBuildNode>, 2> children;
+  uint32_t first_primitive{};
+  uint32_t primitive_count{};
+  uint8_t axis{};
+  // references of a spatial-split leaf until Build gathers them
+  std::vector<BvhPrimitive> references;
+};
+
+class BvhBuilder {
+ public:
+  /**
+   * @param clip clips a primitive against a box for spatial splits, without
+   * it references are clipped by their bounding box only
+   */
+  explicit BvhBuilder(std::vector<BvhPrimitive> primitives,
+                      BvhBuildOptions const& options = {},
+                      BvhClipFunction clip = {});
+
+  /**
+   * @brief Build the hierarchy, partitioning the references in place
+   *
+   * @param depth depth the root will have in the final tree, so that a
+   * subtree rebuilt in place keeps within the traversal stacks
+   * @return the root of the build tree, nullptr if there is no primitive
+   */
+  auto Build(int depth = 0) -> std::unique_ptr<BvhBuildNode>;
+
+  /**
+   * @brief The references in leaf order once Build has returned. Spatial
+   * splits may reference a primitive from several leaves.
+   */
+  [[nodiscard]] auto Primitives() const -> const std::vector<BvhPrimitive>& {
+    return primitives_;
+  }
+  [[nodiscard]] auto NodeCount() const -> uint32_t { return node_count_; }
+
+ private:
+  struct Bucket {
+    Box bounds;
+    uint32_t count = 0;
+
+    void Add(Box const& box);
+    void Merge(Bucket const& bucket);
+  };
+  static constexpr int kBucketCount = 12;
+  static constexpr int kSpatialBinCount = 32;
+  using Bins = std::array<std::array<Bucket, kBucketCount>, 3>;
+  using References = std::span<BvhPrimitive const>;
+
+  struct ObjectSplit {
+    double cost;
+    int axis;
+    int bucket;  // first bucket of the right side, 0 if there is no split
+    Bucket left;
+    Bucket right;
+  };
+  struct SpatialSplit {
+    double cost;
+    int axis;
+    double position;
+    // children as binned, counting every straddling reference on both sides
+    Bucket left;
+    Bucket right;
+  };
+
+  auto BuildRange(uint32_t begin, uint32_t end, int depth)
+      -> std::unique_ptr<BvhBuildNode>;
+  auto BuildSpatial(std::vector<BvhPrimitive> references, int depth)
+      -> std::unique_ptr<BvhBuildNode>;
+  auto BuildMorton(int depth) -> std::unique_ptr<BvhBuildNode>;
+  auto EmitLbvh(uint32_t begin, uint32_t end, int bit, int depth)
+      -> std::unique_ptr<BvhBuildNode>;
+  // treelets are placeholder leaves over their range, replaced by their LBVH
+  // once the top above them is built
+  auto BuildTreeletTop(std::span<std::unique_ptr<BvhBuildNode>> treelets,
+                       int bit, int depth) -> std::unique_ptr<BvhBuildNode>;
+  auto MakeLeaf(uint32_t begin, uint32_t end, Box const& bounds)
+      -> std::unique_ptr<BvhBuildNode>;
+  auto MakeLeaf(std::vector<BvhPrimitive> references, Box const& bounds)
+      -> std::unique_ptr<BvhBuildNode>;
+  [[nodiscard]] auto LeafIsCheaper(uint32_t count, double split_cost,
+                                   Box const& bounds) const -> bool;
+  [[nodiscard]] auto FindObjectSplit(References references,
+                                     Box const& centroid_bounds) const
+      -> ObjectSplit;
+  [[nodiscard]] auto FindSpatialSplit(References references,
+                                      Box const& bounds) const
+      -> SpatialSplit;
+  void SplitReferences(References references, SpatialSplit const& split,
+                       Box const& bounds, std::vector<BvhPrimitive>& left,
+                       std::vector<BvhPrimitive>& right) const;
+  [[nodiscard]] auto ClipReference(BvhPrimitive const& reference,
+                                   Box const& clip) const -> BvhPrimitive;
+  void Gather(BvhBuildNode& node);
+  static void ComputeBounds(References references, Box& bounds,
+                            Box& centroid_bounds);
+  static void ComputeBins(References references, Box const& centroid_bounds,
+                          Bins& bins);
+  static auto BucketIndex(BvhPrimitive const& primitive, int axis,
+                          Box const& centroid_bounds) -> int;
+
+  std::vector<BvhPrimitive> primitives_;
+  // Morton code of every primitive, sorted along with them by BuildMorton
+  std::vector<uint64_t> morton_codes_;
+  BvhBuildOptions options_;
+  BvhClipFunction clip_;
+  std::atomic<uint32_t> node_count_{0};
+  // spatial splits are only tried where children overlap by more than a
+  // fraction of the root area, and while the budget lasts
+  double root_area_ = 0;
+  std::atomic<int64_t> split_budget_{0};
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_ACCELERATION_BVH_BUILDER
@@ -0,0 +1,112 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : geometry_store.h
+// Author      : QRWells
+// Created at  : 2026/10/19 6:10
+// Description : Primitives of a BVH in one contiguous array per type
+
+#ifndef CHERRY_ACCELERATION_GEOMETRY_STORE
+#define CHERRY_ACCELERATION_GEOMETRY_STORE
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/intersection.h"
+#include "common/ray.h"
+#include "core/object.h"
+#include "object/primitive/cuboid.h"
+#include "object/primitive/plane.h"
+#include "object/primitive/sphere.h"
+#include "object/primitive/triangle.h"
+
+namespace cherry {
+class Mesh;
+
+// the array a primitive is stored in; spheres, cuboids and planes also have
+// a SIMD kernel
+enum class PrimitiveKind : uint8_t {
+  kSphere,
+  kCuboid,
+  kPlane,
+  kTriangle,
+  kMesh,
+  kOther
+};
+
+auto KindOf(const Object &object) -> PrimitiveKind;
+
+// what a BVH slot holds: the array of its kind and its entry there
+struct PrimitiveRef {
+  PrimitiveKind kind;
+  uint32_t index;
+
+  friend auto operator<=>(const PrimitiveRef &, const PrimitiveRef &) = default;
+};
+
+/**
+ * @brief Owns the primitives of a BVH: spheres, cuboids, planes and triangles
+ * by value in one array per type, meshes and other objects, too large to
+ * copy, by pointer. BVH slots refer to the entries by PrimitiveRef, and tests
+ * switch on the kind and call the final class directly, so a leaf walks
+ * contiguous memory without indirect calls.
+ *
+ * Every object gets one entry, however many slots refer to it. A hit records
+ * the entry as the object hit, which carries the shape and its material.
+ */
+class GeometryStore {
+ public:
+  /**
+   * @brief Take over the objects, each kind in the order the slots first
+   * refer to it
+   *
+   * @param slots the object of each BVH slot
+   */
+  void Build(std::span<const std::shared_ptr<Object>> objects,
+             std::span<const uint32_t> slots);
+  // copies the objects Build was given over their entries, once they moved
+  void Update(std::span<const std::shared_ptr<Object>> objects);
+  void BindMaterials(MaterialTable &materials);
+
+  // entry of the object-th object Build was given
+  [[nodiscard]] auto Ref(uint32_t object) const -> PrimitiveRef {
+    return refs_[object];
+  }
+  auto Get(PrimitiveRef ref) -> Object &;
+  [[nodiscard]] auto Get(PrimitiveRef ref) const -> const Object &;
+  auto Intersect(PrimitiveRef ref, const Ray &ray, HitRecord &record) const
+      -> bool;
+  [[nodiscard]] auto IntersectP(PrimitiveRef ref, const Ray &ray) const
+      -> bool;
+
+  [[nodiscard]] auto Spheres() const -> std::span<const Sphere> {
+    return spheres_;
+  }
+  [[nodiscard]] auto Cuboids() const -> std::span<const Cuboid> {
+    return cuboids_;
+  }
+  [[nodiscard]] auto Planes() const -> std::span<const Plane> {
+    return planes_;
+  }
+
+ private:
+  // calls visit with the primitive ref points to, as its final class
+  template <typename Self, typename Visitor>
+  static auto Visit(Self &self, PrimitiveRef ref, Visitor &&visit)
+      -> decltype(auto);
+
+  std::vector<PrimitiveRef> refs_;
+  std::vector<Sphere> spheres_;
+  std::vector<Cuboid> cuboids_;
+  std::vector<Plane> planes_;
+  std::vector<Triangle> triangles_;
+  std::vector<std::shared_ptr<Mesh>> meshes_;
+  std::vector<std::shared_ptr<Object>> others_;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_ACCELERATION_GEOMETRY_STORE
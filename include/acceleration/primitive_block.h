@@ -0,0 +1,80 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : primitive_block.h
+// Author      : QRWells
+// Created at  : 2026/10/19 5:35
+// Description : SoA copies of the analytic primitives of BVH leaves
+
+#ifndef CHERRY_ACCELERATION_PRIMITIVE_BLOCK
+#define CHERRY_ACCELERATION_PRIMITIVE_BLOCK
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "acceleration/geometry_store.h"
+#include "common/intersection.h"
+#include "common/ray.h"
+
+namespace cherry {
+/**
+ * @brief Spheres, cuboids and planes of the slots of a BVH, laid out from
+ * its GeometryStore as one double precision SoA array per type in slot order.
+ *
+ * Leaves sort their primitives by kind, so a leaf is made of runs of one
+ * type that map to consecutive entries of that type's arrays. A run is tested
+ * with a single SSE2 or AVX kernel per type, and the nearest lane it reports
+ * is recorded. Lone primitives and the other kinds are tested by the store.
+ * The kernels repeat the arithmetic of the scalar tests, so hits are the
+ * same.
+ */
+class PrimitiveBlocks {
+ public:
+  // slots holds the entry of store each BVH slot refers to
+  void Build(const GeometryStore &store, std::span<const PrimitiveRef> slots);
+
+  /**
+   * @brief Closest hit among the slots [offset, offset + count), narrowing
+   * ray.t_max to it
+   *
+   * @param store, slots what the blocks were built from
+   */
+  auto Intersect(const GeometryStore &store,
+                 std::span<const PrimitiveRef> slots, uint32_t offset,
+                 uint32_t count, Ray &ray, HitRecord &record) const -> bool;
+  // whether any primitive of the slots [offset, offset + count) is hit
+  [[nodiscard]] auto IntersectP(const GeometryStore &store,
+                                std::span<const PrimitiveRef> slots,
+                                uint32_t offset, uint32_t count,
+                                const Ray &ray) const -> bool;
+
+  // arrays of each kind, padded so that a SIMD load at the last entry stays
+  // in bounds
+  struct SphereArrays {
+    std::vector<double> center_x, center_y, center_z, radius2;
+  };
+  struct CuboidArrays {
+    std::vector<double> min_x, min_y, min_z, max_x, max_y, max_z;
+  };
+  struct PlaneArrays {
+    std::vector<double> position_x, position_y, position_z;
+    std::vector<double> normal_x, normal_y, normal_z;
+    std::vector<double> e1_x, e1_y, e1_z, e1_norm2;
+    std::vector<double> e2_x, e2_y, e2_z, e2_norm2;
+    // 1 for bounded planes, 0 for unbounded ones
+    std::vector<double> bounded;
+  };
+
+ private:
+  SphereArrays spheres_;
+  CuboidArrays cuboids_;
+  PlaneArrays planes_;
+  // entry of each slot in the arrays of its kind
+  std::vector<uint32_t> entries_;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_ACCELERATION_PRIMITIVE_BLOCK
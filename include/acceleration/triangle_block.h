@@ -0,0 +1,90 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : triangle_block.h
+// Author      : QRWells
+// Created at  : 2026/10/19 4:20
+// Description : SoA triangle blocks tested with one SIMD kernel
+
+#ifndef CHERRY_ACCELERATION_TRIANGLE_BLOCK
+#define CHERRY_ACCELERATION_TRIANGLE_BLOCK
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "common/ray.h"
+#include "math/vector.h"
+
+namespace cherry {
+/**
+ * @brief Up to kLanes triangles of a BVH leaf as single precision SoA lanes,
+ * the first vertex and both edges of each. Vertices are stored relative to
+ * origin so that their precision follows the size of the leaf rather than its
+ * distance to the scene origin. Unused lanes have zero edges.
+ */
+template <int kLanes>
+struct alignas(32) TriangleBlock {
+  static constexpr int kWidth = kLanes;
+
+  std::array<float, kWidth> v0_x;
+  std::array<float, kWidth> v0_y;
+  std::array<float, kWidth> v0_z;
+  std::array<float, kWidth> e1_x;
+  std::array<float, kWidth> e1_y;
+  std::array<float, kWidth> e1_z;
+  std::array<float, kWidth> e2_x;
+  std::array<float, kWidth> e2_y;
+  std::array<float, kWidth> e2_z;
+  math::Point3 origin;
+  // bounds the L1 norm of every stored vertex and edge, scales the error
+  // allowed for by the kernel
+  float extent;
+};
+static_assert(sizeof(TriangleBlock<4>) == 192);
+static_assert(sizeof(TriangleBlock<8>) == 320);
+
+// lanes filled by the meshes of this build
+#if defined(__AVX__)
+constexpr int kTriangleBlockWidth = 8;
+#else
+constexpr int kTriangleBlockWidth = 4;
+#endif
+
+// ray constants shared by all the blocks a traversal visits
+struct TriangleBlockRay {
+  math::Point3 origin;
+  std::array<float, 3> direction;
+  float direction_norm;
+  float t_min;
+};
+
+auto MakeTriangleBlockRay(const Ray &ray) -> TriangleBlockRay;
+
+/**
+ * @brief Pack triangles, three vertices each, at most kLanes of them
+ */
+template <int kLanes>
+auto MakeTriangleBlock(std::span<const std::array<math::Point3, 3>> triangles)
+    -> TriangleBlock<kLanes>;
+
+/**
+ * @brief Möller-Trumbore test of all lanes at once in single precision.
+ *
+ * The result is conservative: every lane whose triangle the double precision
+ * test hits front-facing within [t_min, t_max] is set, and a few grazing ones
+ * may be set as well, so callers confirm the lanes in double precision. This
+ * keeps hits identical to testing the triangles one by one.
+ *
+ * @param count number of lanes in use
+ * @return bit mask of the candidate lanes
+ */
+template <int kLanes>
+auto TriangleBlockCandidates(const TriangleBlock<kLanes> &block,
+                             const TriangleBlockRay &ray, double t_max,
+                             int count) -> uint32_t;
+}  // namespace cherry
+
+#endif  // !CHERRY_ACCELERATION_TRIANGLE_BLOCK
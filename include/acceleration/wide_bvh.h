@@ -0,0 +1,72 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : wide_bvh.h
+// Author      : QRWells
+// Created at  : 2026/10/18 16:37
+// Description : Collapsed 4-wide / 8-wide BVH node layouts
+
+#ifndef CHERRY_ACCELERATION_WIDE_BVH
+#define CHERRY_ACCELERATION_WIDE_BVH
+
+#include <array>
+#include <cstdint>
+
+namespace cherry {
+/**
+ * @brief Node of a BVH collapsed to kWidth children per node.
+ *
+ * Child bounds are stored as single precision SoA lanes so that one SIMD slab
+ * test checks every child at once. Leaf children are not separate nodes: their
+ * primitive range is stored directly in the parent. Unused lanes have all
+ * bounds set to +inf, which no ray can enter.
+ */
+template <int kLanes>
+struct alignas(64) WideBvhNode {
+  static constexpr int kWidth = kLanes;
+
+  std::array<float, kWidth> min_x;
+  std::array<float, kWidth> min_y;
+  std::array<float, kWidth> min_z;
+  std::array<float, kWidth> max_x;
+  std::array<float, kWidth> max_y;
+  std::array<float, kWidth> max_z;
+  // child node index, or first primitive of a leaf child
+  std::array<uint32_t, kWidth> offset;
+  // primitive count of a leaf child, 0 for interior children
+  std::array<uint16_t, kWidth> count;
+};
+static_assert(sizeof(WideBvhNode<4>) == 128);
+static_assert(sizeof(WideBvhNode<8>) == 256);
+
+/**
+ * @brief Wide node with the child bounds quantized to 8 bits per plane.
+ *
+ * Along each axis a child plane decodes to origin + q * 2^exponent. The origin
+ * is a multiple of the scale, so decoding is exact in single precision, and
+ * the planes are rounded outwards, so a decoded box always contains the child.
+ * Lanes from child_count on are unused.
+ */
+template <int kLanes>
+struct alignas(64) CompressedBvhNode {
+  static constexpr int kWidth = kLanes;
+
+  std::array<float, 3> origin;
+  std::array<int8_t, 3> exponent;
+  uint8_t child_count;
+  std::array<uint8_t, kWidth> min_x;
+  std::array<uint8_t, kWidth> min_y;
+  std::array<uint8_t, kWidth> min_z;
+  std::array<uint8_t, kWidth> max_x;
+  std::array<uint8_t, kWidth> max_y;
+  std::array<uint8_t, kWidth> max_z;
+  std::array<uint32_t, kWidth> offset;
+  std::array<uint16_t, kWidth> count;
+};
+static_assert(sizeof(CompressedBvhNode<4>) == 64);
+static_assert(sizeof(CompressedBvhNode<8>) == 128);
+}  // namespace cherry
+
+#endif  // !CHERRY_ACCELERATION_WIDE_BVH
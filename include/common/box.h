@@ -11,6 +11,8 @@
 #ifndef CHERRY_COMMON_BOX
 #define CHERRY_COMMON_BOX
 
+#include <span>
+
 #include "common/intersection.h"
 #include "common/ray.h"
 #include "math/vector.h"
@@ -37,10 +39,30 @@ struct Box {
   [[nodiscard]] auto MaxExtent() const -> int;
   [[nodiscard]] auto Offset(math::Point3 const& p) const -> math::Vector3d;
   [[nodiscard]] auto Intersect(Ray const&, Intersection&) const -> bool;
+  /**
+   * @brief Slab test against the [t_min, t_max] interval of the ray
+   *
+   * @return true if the ray enters the box within its interval
+   */
+  [[nodiscard]] auto IntersectP(Ray const&) const -> bool;
   [[nodiscard]] auto Union(Box const&) const -> Box;
+  // overlap of the two boxes, Empty() if they are disjoint
+  [[nodiscard]] auto Clip(Box const&) const -> Box;
+  [[nodiscard]] auto Empty() const -> bool {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
   [[nodiscard]] auto Overlaps(Box const&) const -> bool;
   [[nodiscard]] auto Inside(math::Point3 const&) const -> bool;
 };
+
+/**
+ * @brief Bounds of the part of a convex planar polygon inside a box
+ *
+ * @param polygon vertices in order, at most ten
+ * @return Empty() box if the polygon lies outside the clip box
+ */
+auto ClippedBounds(std::span<math::Point3 const> polygon, Box const& clip)
+    -> Box;
 }  // namespace cherry
 
 #endif  // !CHERRY_COMMON_BOX
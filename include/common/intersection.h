@@ -11,24 +11,78 @@
 #ifndef INTERSECTION
 #define INTERSECTION
 
-#include <memory>
+#include <cmath>
+#include <cstdint>
 
+#include "common/ray.h"
 #include "common/shading_point.h"
+#include "core/material_table.h"
 #include "math/vector.h"
 #include "utility/constant.h"
 
 namespace cherry {
 class Object;
-class Material;
 struct Intersection {
  public:
   Intersection() = default;
   math::Point3 coordinate;
+  // bound on the absolute error of coordinate along each axis
+  math::Vector3d error;
   math::Vector3d normal;
   ShadingPoint shading_point;
-  std::shared_ptr<Material> material = nullptr;
+  // texture coordinates, set by surfaces that carry them
+  math::Point2 uv;
+  // resolved through the MaterialTable of the scene
+  MaterialId material = kNoMaterial;
   double distance = INFINITY;
 };
+
+/**
+ * @brief What a traversal keeps of a candidate hit. The Intersection of the
+ * closest one is computed once from it by the object that was hit.
+ */
+struct HitRecord {
+  double distance = INFINITY;
+  // the primitive that was hit
+  const Object *object = nullptr;
+  // the Instance the primitive was reached through, if any; instances of
+  // hierarchies that hold instances themselves are not supported
+  const Object *instance = nullptr;
+  // element of object that was hit, such as a triangle of a mesh
+  uint32_t primitive = 0;
+  // barycentric coordinates of the hit on that triangle
+  double b1 = 0;
+  double b2 = 0;
+};
+
+/**
+ * @brief Origin of a ray leaving a surface point toward direction. The point
+ * is pushed along the normal, to the side direction points to, by the bound
+ * on its error and then rounded away from the surface, so the ray cannot hit
+ * that surface again at a positive distance.
+ */
+inline auto OffsetRayOrigin(const math::Point3 &point,
+                            const math::Vector3d &error,
+                            const math::Vector3d &normal,
+                            const math::Vector3d &direction) -> math::Point3 {
+  auto offset = normal * normal.Abs().Dot(error);
+  if (direction.Dot(normal) < 0) offset = -offset;
+  auto origin = point + offset;
+  for (int i = 0; i < 3; ++i) {
+    if (offset[i] > 0)
+      origin[i] = std::nextafter(origin[i], INFINITY);
+    else if (offset[i] < 0)
+      origin[i] = std::nextafter(origin[i], -INFINITY);
+  }
+  return origin;
+}
+
+// ray leaving the point of hit toward direction
+inline auto SpawnRay(const Intersection &hit, const math::Vector3d &direction)
+    -> Ray {
+  return {OffsetRayOrigin(hit.coordinate, hit.error, hit.normal, direction),
+          direction};
+}
 }  // namespace cherry
 
 #endif  // !INTERSECTION
@@ -12,12 +12,16 @@
 #define CHERRY_COMMON_RAY
 
 #include "math/vector.h"
+#include "utility/constant.h"
 
 namespace cherry {
 struct Ray {
   math::Point3 origin;
   math::Vector3d direction;
   math::Vector3d direction_inv;
+  // parametric interval [t_min, t_max] in which hits are accepted
+  double t_min = 0.0;
+  double t_max = INF;
 
   Ray() = default;
 
@@ -0,0 +1,34 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : ray_packet.h
+// Author      : QRWells
+// Created at  : 2026/10/18 23:05
+// Description : Coherent rays traced together
+
+#ifndef CHERRY_COMMON_RAY_PACKET
+#define CHERRY_COMMON_RAY_PACKET
+
+#include <array>
+#include <cstdint>
+
+#include "common/ray.h"
+
+namespace cherry {
+inline constexpr int kPacketSize = 8;
+
+/**
+ * @brief Rays with similar origins and directions, such as the camera rays of
+ * neighbouring pixels, that are traced together so that they share node
+ * fetches. Results are reported as bit masks over the lanes.
+ */
+struct RayPacket {
+  std::array<Ray, kPacketSize> rays;
+  // bit i is set when rays[i] is in use
+  uint32_t mask = 0;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_COMMON_RAY_PACKET
@@ -2,7 +2,11 @@
 #ifndef CHERRY_CORE_INTEGRATOR
 #define CHERRY_CORE_INTEGRATOR
 
+#include <bit>
+#include <span>
+
 #include "common/ray.h"
+#include "common/ray_packet.h"
 #include "math/vector.h"
 #include "scene.h"
 
@@ -19,6 +23,34 @@ class Integrator {
   virtual ~Integrator() = default;
   virtual auto Li(const Ray& ray, const std::shared_ptr<Scene>& scene)
       -> math::Point3 = 0;
+  /**
+   * @brief Radiance along every ray of a coherent packet, such as the camera
+   * rays of neighbouring pixels. Integrators that trace the packet together
+   * override this; by default the rays are traced one by one.
+   */
+  virtual void Li(const RayPacket& packet, const std::shared_ptr<Scene>& scene,
+                  std::span<math::Point3, kPacketSize> radiance) {
+    for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+      auto const kLane = std::countr_zero(lanes);
+      radiance[kLane] = Li(packet.rays[kLane], scene);
+    }
+  }
+  /**
+   * @brief Number of camera rays the renderer should hand over at once to the
+   * batch Li. 0, the default, asks for packets of neighbouring pixels instead.
+   */
+  [[nodiscard]] virtual auto BatchSize() const -> size_t { return 0; }
+  /**
+   * @brief Radiance along every ray of a batch of BatchSize() camera rays or
+   * fewer. Integrators that trace whole batches stage by stage override this.
+   */
+  virtual void Li(std::span<const Ray> rays,
+                  const std::shared_ptr<Scene>& scene,
+                  std::span<math::Point3> radiance) {
+    for (size_t i = 0; i < rays.size(); ++i) radiance[i] = Li(rays[i], scene);
+  }
+  // prints statistics of everything traced so far, if the integrator keeps any
+  virtual void ReportStats() const {}
 };
 }  // namespace cherry
 
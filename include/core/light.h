@@ -20,10 +20,14 @@ struct Light : Object {
   explicit Light(double const& intensity) : intensity(intensity) {}
   double intensity = 0;
 
-  auto Intersect(const Ray& ray, Intersection& inter) const -> bool override {
+  auto Intersect(const Ray& ray, HitRecord& record) const -> bool override {
     return false;
   }
+  void ComputeIntersection(const Ray& ray, const HitRecord& record,
+                           Intersection& inter) const override {}
+  auto IntersectP(const Ray& ray) const -> bool override { return false; }
   auto GetBounds() -> Box override { return {}; }
+  void Translate(const math::Vector3d& offset) override = 0;
   void Sample(Intersection& inter, double& d) override = 0;
   [[nodiscard]] auto HasEmission() const -> bool override { return true; }
   [[nodiscard]] auto GetSurfaceArea() const -> double override { return 0; }
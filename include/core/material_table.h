@@ -0,0 +1,46 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : material_table.h
+// Author      : QRWells
+// Created at  : 2026/10/19 7:10
+// Description : Materials of a scene, referenced by index while rendering
+
+#ifndef CHERRY_CORE_MATERIAL_TABLE
+#define CHERRY_CORE_MATERIAL_TABLE
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace cherry {
+class Material;
+
+// index of a material in the table of the scene it is rendered in
+using MaterialId = uint32_t;
+constexpr MaterialId kNoMaterial = UINT32_MAX;
+
+/**
+ * @brief Owns the materials of a scene. Objects keep their shared_ptr for
+ * construction and register it once, hits and light samples then carry the
+ * 32 bit id, so rendering threads never touch a reference count.
+ */
+class MaterialTable {
+ public:
+  // id of material, added on its first use; kNoMaterial for nullptr
+  auto Add(const std::shared_ptr<Material> &material) -> MaterialId;
+  [[nodiscard]] auto operator[](MaterialId id) const -> Material & {
+    return *materials_[id];
+  }
+  [[nodiscard]] auto Size() const -> size_t { return materials_.size(); }
+
+ private:
+  std::vector<std::shared_ptr<Material>> materials_;
+  std::unordered_map<const Material *, MaterialId> ids_;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_CORE_MATERIAL_TABLE
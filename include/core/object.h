@@ -23,12 +23,40 @@ class Object {
  public:
   Object() = default;
   virtual ~Object() = default;
-  virtual auto Intersect(const Ray &, Intersection &) const -> bool = 0;
+  // records the hit when it lies within the ray interval, without computing
+  // any shading attributes
+  virtual auto Intersect(const Ray &, HitRecord &) const -> bool = 0;
+  // the attributes of a hit recorded by Intersect with the same ray
+  virtual void ComputeIntersection(const Ray &, const HitRecord &,
+                                   Intersection &) const = 0;
+  // any-hit test within the ray interval, no shading attributes computed
+  virtual auto IntersectP(const Ray &) const -> bool = 0;
   virtual auto GetBounds() -> Box = 0;
+  // bounds of the part of the surface inside clip, used by spatial splits
+  virtual auto ClipBounds(const Box &clip) -> Box {
+    return GetBounds().Clip(clip);
+  }
+  // appends the points ClipBounds depends on beyond the bounds, which the
+  // key of a cached hierarchy hashes; none when it only clips the bounds
+  virtual void AppendClipPoints(
+      std::vector<math::Point3> & /*points*/) const {}
+  // moves the object, a built Bvh picks this up with Refit
+  virtual void Translate(const math::Vector3d &offset) = 0;
+  // adds the materials of the object to the table of the scene it is added
+  // to, the ids written to its hits and samples come from there
+  virtual void BindMaterials(MaterialTable & /*materials*/) {}
   virtual void Sample(Intersection &, double &) = 0;
 
   [[nodiscard]] virtual auto HasEmission() const -> bool = 0;
   [[nodiscard]] virtual auto GetSurfaceArea() const -> double = 0;
 };
+
+// the Intersection of the closest hit of a traversal
+inline void FillIntersection(const Ray &ray, const HitRecord &record,
+                             Intersection &intersection) {
+  auto const *owner =
+      record.instance != nullptr ? record.instance : record.object;
+  owner->ComputeIntersection(ray, record, intersection);
+}
 }  // namespace cherry
 #endif  // !OBJECT
@@ -30,16 +30,23 @@ class RayTracer final : public Renderer {
   explicit RayTracer(const std::shared_ptr<Scene>& scene, const uint32_t& width,
                      const uint32_t& height,
                      std::shared_ptr<Integrator> integrator,
-                     const size_t& spp = 64)
+                     const size_t& spp = 64,
+                     const BvhBuildOptions& bvh_options = {})
       : Renderer(scene, width, height),
         spp(spp),
         integrator_(std::move(integrator)) {
-    scene->BuildBvh();
+    scene->BuildBvh(bvh_options);
   }
 
   void Render() override;
 
  private:
+  // pixel rows in packets, one row range per thread
+  void RenderPackets();
+  // all samples of the image in batches of integrator_->BatchSize(), the
+  // integrator spreads each batch over the threads
+  void RenderBatches();
+
   std::shared_ptr<Integrator> integrator_;
 };
 }  // namespace cherry
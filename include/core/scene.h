@@ -11,11 +11,13 @@
 #ifndef CHERRY_CORE_SCENE
 #define CHERRY_CORE_SCENE
 
+#include <span>
 #include <vector>
 
 #include "acceleration/bvh.h"
 #include "core/camera.h"
 #include "core/light.h"
+#include "core/material_table.h"
 #include "core/object.h"
 
 namespace cherry {
@@ -32,8 +34,12 @@ class Scene {
   std::vector<std::shared_ptr<Object>> objects_;
   // emitting objects including light(non-hittable) and hittable objects
   std::vector<std::shared_ptr<Object>> lights_;
+  // the materials of the objects, hits refer to them by id
+  MaterialTable materials_;
   // the bvh tree for acceleration
   Bvh bvh_;
+  // number of objects the bvh was built over
+  size_t bvh_object_count_ = 0;
 
  public:
   [[nodiscard]] auto GetObjects() const
@@ -41,9 +47,43 @@ class Scene {
   [[nodiscard]] auto GetLights() const
       -> const std::vector<std::shared_ptr<Object>>&;
   void SampleLight(Intersection&, double&) const;
+  [[nodiscard]] auto GetMaterial(MaterialId id) const -> Material& {
+    return materials_[id];
+  }
+  // bounds of the objects in the BVH, empty before BuildBvh
+  [[nodiscard]] auto Bounds() const -> Box { return bvh_.Bounds(); }
   void Add(const std::shared_ptr<Object>& object);
   auto Intersect(const Ray& ray, Intersection& intersection) const -> bool;
-  void BuildBvh();
+  /**
+   * @brief Test whether anything blocks the ray before max_distance
+   *
+   * @param ray shadow ray, max_distance is measured in units of its direction
+   * @param max_distance upper bound of the tested interval
+   * @return true if any object is hit in [ray.t_min, max_distance]
+   */
+  [[nodiscard]] auto Occluded(const Ray& ray, double max_distance) const
+      -> bool;
+  /**
+   * @brief Trace a packet of coherent rays together
+   *
+   * @return bit mask of the lanes that hit an object, their closest hit is
+   * stored in intersections
+   */
+  auto Intersect(const RayPacket& packet,
+                 std::span<Intersection, kPacketSize> intersections) const
+      -> uint32_t;
+  /**
+   * @brief Shadow test of a packet of coherent rays, e.g. toward one light
+   * sample. Every ray is tested up to its own t_max.
+   *
+   * @return bit mask of the lanes that are blocked
+   */
+  [[nodiscard]] auto Occluded(const RayPacket& packet) const -> uint32_t;
+  /**
+   * @brief Build the BVH, or only refit it when neither the object list nor
+   * the options changed since the last build (objects may have moved)
+   */
+  void BuildBvh(const BvhBuildOptions& options = {});
 };
 }  // namespace cherry
 
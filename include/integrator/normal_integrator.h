@@ -20,6 +20,8 @@ class NormalIntegrator final : public Integrator {
  public:
   auto Li(const Ray& ray, const std::shared_ptr<Scene>& scene)
       -> math::Point3 override;
+  void Li(const RayPacket& packet, const std::shared_ptr<Scene>& scene,
+          std::span<math::Point3, kPacketSize> radiance) override;
 };
 }  // namespace cherry
 #endif  //! CHERRY_INTEGRATOR_NORMAL_INTEGRATOR
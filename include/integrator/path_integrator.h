@@ -19,6 +19,10 @@ class PathIntegrator final : public Integrator {
   PathIntegrator() = default;
   auto Li(Ray const& ray, std::shared_ptr<Scene> const& scene)
       -> math::Point3 override;
+  // the camera rays and the shadow rays of their first hits go through the
+  // BVH as packets, the rest of every path is traced alone
+  void Li(RayPacket const& packet, std::shared_ptr<Scene> const& scene,
+          std::span<math::Point3, kPacketSize> radiance) override;
 };
 }  // namespace cherry
 
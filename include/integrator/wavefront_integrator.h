@@ -0,0 +1,58 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : wavefront_integrator.h
+// Author      : QRWells
+// Created at  : 2026/10/18 23:40
+// Description : Path tracer running batches of paths stage by stage
+
+#ifndef CHERRY_INTEGRATOR_WAVEFRONT
+#define CHERRY_INTEGRATOR_WAVEFRONT
+
+#include "core/integrator.h"
+
+namespace cherry {
+struct WavefrontOptions {
+  // paths advanced together, every queue holds this many entries
+  size_t batch_size = size_t{1} << 16;
+  // bins the secondary and shadow rays of every bounce by direction octant
+  // and the Morton code of their origin before they are traced
+  bool sort_rays = false;
+};
+
+/**
+ * @brief Path tracer with the estimator of PathIntegrator that advances a
+ * whole batch of paths one bounce at a time. Every bounce runs the same
+ * stages over all live paths: extend (closest hit), shade (grouped by
+ * material kind), shadow (occlusion of the light samples) and accumulate.
+ * Rays, hits and path state are kept in structure-of-arrays queues so that a
+ * stage streams through contiguous arrays and keeps its code hot.
+ */
+class WavefrontIntegrator final : public Integrator {
+ public:
+  explicit WavefrontIntegrator(WavefrontOptions const& options = {})
+      : options_(options) {}
+
+  // traces a batch of one path
+  auto Li(Ray const& ray, std::shared_ptr<Scene> const& scene)
+      -> math::Point3 override;
+  [[nodiscard]] auto BatchSize() const -> size_t override {
+    return options_.batch_size;
+  }
+  void Li(std::span<Ray const> rays, std::shared_ptr<Scene> const& scene,
+          std::span<math::Point3> radiance) override;
+  // rays traced and their throughput, including the time spent sorting
+  void ReportStats() const override;
+
+ private:
+  WavefrontOptions options_;
+  uint64_t extension_rays_ = 0;
+  uint64_t shadow_rays_ = 0;
+  double trace_seconds_ = 0.0;
+  double sort_seconds_ = 0.0;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_INTEGRATOR_WAVEFRONT
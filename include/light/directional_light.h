@@ -21,6 +21,7 @@ struct DirectionalLight final : public Light {
   }
 
   void Sample(Intersection&, double&) override;
+  void Translate(const math::Vector3d& offset) override;
 
  private:
   math::Vector3d shoot_from_;
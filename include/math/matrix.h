@@ -35,15 +35,15 @@ struct Matrix4 {
     value_[8] = v31, value_[9] = v32, value_[10] = v33, value_[11] = v34;
     value_[12] = v41, value_[13] = v42, value_[14] = v43, value_[15] = v44;
   }
-  Matrix4(Matrix4<T> const& that) : value_(nullptr) { *this = that; }
-  Matrix4(Matrix4<T>&& that) noexcept { *this = std::move(that); }
+  Matrix4(Matrix4<T> const&) = default;
+  Matrix4(Matrix4<T>&&) noexcept = default;
   ~Matrix4() = default;
 
   static const Matrix4<T> ZERO;
   static const Matrix4<T> IDENTITY;
 
-  auto operator=(Matrix4<T> const&) noexcept -> Matrix4<T>&;
-  auto operator=(Matrix4<T>&&) noexcept -> Matrix4<T>&;
+  auto operator=(Matrix4<T> const&) -> Matrix4<T>& = default;
+  auto operator=(Matrix4<T>&&) noexcept -> Matrix4<T>& = default;
 
   auto operator()(int const& i, int const& j) const -> T const& {
     if (i < 1 || i > 4 || j < 1 || j > 4) return value_[0];
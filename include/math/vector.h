@@ -286,7 +286,9 @@ struct Vector3 {
 
   void Formalize() { Clamp(0.0, 1.0); }
 
-  auto Abs() -> Vector3<T> { return {std::abs(x), std::abs(y), std::abs(z)}; }
+  [[nodiscard]] auto Abs() const -> Vector3<T> {
+    return {std::abs(x), std::abs(y), std::abs(z)};
+  }
 
   [[nodiscard]] auto AsPoint() const -> Vector4<T> { return {*this, true}; }
   [[nodiscard]] auto AsVector() const -> Vector4<T> { return {*this, false}; }
@@ -0,0 +1,55 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : instance.h
+// Author      : QRWells
+// Created at  : 2026/10/18 18:05
+// Description : Transformed reference to a shared bottom-level BVH
+
+#ifndef CHERRY_OBJECT_INSTANCE
+#define CHERRY_OBJECT_INSTANCE
+
+#include <memory>
+
+#include "acceleration/bvh.h"
+#include "core/object.h"
+#include "math/matrix.h"
+
+namespace cherry {
+/**
+ * @brief Placement of a shared bottom-level BVH in the scene.
+ *
+ * Any number of instances may reference the same hierarchy, so a repeated
+ * asset is stored once plus one transform per copy. Rays are moved into
+ * object space at the instance boundary; the direction is not renormalized,
+ * which keeps hit distances identical in both spaces. Instances are not
+ * sampled as lights.
+ */
+class Instance final : public Object {
+ public:
+  Instance(std::shared_ptr<Bvh> blas, const math::Matrix &object_to_world);
+
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool override;
+  void ComputeIntersection(const Ray &ray, const HitRecord &record,
+                           Intersection &intersection) const override;
+  auto IntersectP(const Ray &ray) const -> bool override;
+  auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d &offset) override;
+  void BindMaterials(MaterialTable &materials) override;
+  void Sample(Intersection &intersection, double &pdf) override;
+  [[nodiscard]] auto HasEmission() const -> bool override;
+  [[nodiscard]] auto GetSurfaceArea() const -> double override;
+
+ private:
+  [[nodiscard]] auto ToObject(const Ray &ray) const -> Ray;
+
+  std::shared_ptr<Bvh> blas_;
+  math::Matrix object_to_world_;
+  math::Matrix world_to_object_;
+  Box bounds_;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_OBJECT_INSTANCE
@@ -6,41 +6,145 @@
 // File Name   : mesh.h
 // Author      : QRWells
 // Created at  : 2021/08/31 23:51
-// Description :
+// Description : Indexed triangle mesh with its own BVH
 
 #ifndef CHERRY_OBJECT_MESH
 #define CHERRY_OBJECT_MESH
 
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "acceleration/bvh.h"
+#include "acceleration/triangle_block.h"
 #include "core/object.h"
-#include "primitive/triangle.h"
+#include "utility/mapped_file.h"
+#include "utility/mesh_file.h"
 
 namespace cherry {
+/**
+ * @brief Triangle mesh stored as shared vertex arrays and an index buffer,
+ * three entries of vertex_index per triangle, instead of one Object per face.
+ * A BVH local to the mesh is built over the triangles, which are reordered so
+ * that every leaf covers a contiguous range of them. Leaves hold at most
+ * kTriangleBlockWidth triangles, which are also packed into one TriangleBlock
+ * per leaf and tested together. Like Triangle, faces are hit from the front
+ * only.
+ */
 class Mesh final : public Object {
  public:
-  void LoadObj(const std::string &);
+  explicit Mesh(std::shared_ptr<Material> material);
 
-  auto Intersect(const Ray &ray, Intersection &intersection) const
-      -> bool override;
+  // LoadBinary for files ending in .cmesh, LoadPly for .ply, LoadObj
+  // otherwise
+  auto Load(const std::string &path) -> bool;
+  /**
+   * @brief Replace the geometry with the faces of an OBJ file, see ReadObj
+   *
+   * @return false if the file cannot be read or holds no face
+   */
+  auto LoadObj(const std::string &path) -> bool;
+  // as LoadObj for a binary PLY file, see ReadPly
+  auto LoadPly(const std::string &path) -> bool;
+  /**
+   * @brief Map a file written by SaveBinary. The mesh reads its arrays and
+   * BVH straight from the mapping, so processes loading the same file share
+   * its pages; Translate copies them into memory first.
+   *
+   * @return false if the file cannot be read or was not written by SaveBinary
+   * for this build
+   */
+  auto LoadBinary(const std::string &path) -> bool;
+  /**
+   * @brief Write the geometry and BVH as a native-endian Cherry mesh file,
+   * each array aligned to a cache line
+   *
+   * @param pack_normals store normals octahedral encoded in 32 bits instead
+   * of three doubles
+   * @return false if the file cannot be written
+   */
+  auto SaveBinary(const std::string &path, bool pack_normals = false) const
+      -> bool;
+  /**
+   * @brief Replace the geometry and build the BVH
+   *
+   * @param normals per vertex, or empty to shade with the face normals
+   * @param uvs per vertex texture coordinates, or empty
+   */
+  void SetGeometry(std::vector<math::Point3> positions,
+                   std::vector<uint32_t> vertex_index,
+                   std::vector<math::Vector3d> normals = {},
+                   std::vector<math::Point2> uvs = {});
+  void SetGeometry(MeshData data);
+
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool override;
+  void ComputeIntersection(const Ray &ray, const HitRecord &record,
+                           Intersection &intersection) const override;
+  auto IntersectP(const Ray &ray) const -> bool override;
   auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d &offset) override;
+  void BindMaterials(MaterialTable &materials) override;
+  // a point uniformly distributed over the surface
   void Sample(Intersection &intersection, double &pdf) override;
   [[nodiscard]] auto HasEmission() const -> bool override;
   [[nodiscard]] auto GetSurfaceArea() const -> double override;
 
-  uint32_t num_triangles;
-  double area;
-  Box bounding_box;
-  Bvh bvh;
-  std::shared_ptr<Material> material;
-  std::vector<math::Vector3d> vertices;
-  std::vector<uint32_t> vertex_index;
-  std::vector<math::Vector2d> st_coordinates;
-  std::vector<Triangle> triangles;
+  [[nodiscard]] auto TriangleCount() const -> uint32_t {
+    return static_cast<uint32_t>(vertex_index_.size() / 3);
+  }
+  [[nodiscard]] auto VertexCount() const -> uint32_t {
+    return static_cast<uint32_t>(positions_.size());
+  }
+
+ private:
+  void Build();
+  // packs the triangles of every leaf and numbers the leaves after them
+  void BuildBlocks();
+  // points the arrays at the owned storage
+  void Bind();
+  // copies a mapped mesh into owned storage so that it can be modified
+  void Detach();
+  // Möller-Trumbore test of triangle, b1 and b2 are the barycentric
+  // coordinates of its second and third vertex at the hit
+  auto HitTriangle(uint32_t triangle, const Ray &ray, double &t, double &b1,
+                   double &b2) const -> bool;
+  // closest hit below the BVH, or the first one when any_hit is set
+  auto Traverse(const Ray &ray, bool any_hit, uint32_t &triangle, double &t,
+                double &b1, double &b2) const -> bool;
+  [[nodiscard]] auto Vertex(uint32_t triangle, int corner) const
+      -> const math::Point3 & {
+    return positions_[vertex_index_[3 * triangle + corner]];
+  }
+  [[nodiscard]] auto Normal(uint32_t vertex) const -> math::Vector3d {
+    return packed_normals_.empty() ? normals_[vertex]
+                                   : UnpackNormal(packed_normals_[vertex]);
+  }
+
+  // the arrays traversed: the owned storage below or a mapped file. At most
+  // one of normals_ and packed_normals_ is set.
+  std::span<math::Point3 const> positions_;
+  std::span<math::Vector3d const> normals_;
+  std::span<uint32_t const> packed_normals_;
+  std::span<math::Point2 const> uvs_;
+  std::span<uint32_t const> vertex_index_;
+  // leaves index triangles, which are stored in leaf order, and their block
+  // through first_child_offset
+  std::span<LinearBvhNode const> nodes_;
+  std::span<TriangleBlock<kTriangleBlockWidth> const> blocks_;
+  // running sum of the triangle areas, for area-weighted sampling
+  std::span<double const> area_cdf_;
+
+  // empty while the arrays are mapped
+  MeshData data_;
+  std::vector<uint32_t> packed_normal_data_;
+  std::vector<LinearBvhNode> node_data_;
+  std::vector<TriangleBlock<kTriangleBlockWidth>> block_data_;
+  std::vector<double> area_cdf_data_;
+  std::shared_ptr<MappedFile const> mapping_;
+  std::shared_ptr<Material> material_;
+  MaterialId material_id_ = kNoMaterial;
 };
 }  // namespace cherry
 
-#endif  // !CHERRY_OBJECT_MESH_TRIANGLE
+#endif  // !CHERRY_OBJECT_MESH
@@ -35,18 +35,32 @@ class Cuboid final : public Object {
     area_ = Box(min, max).SurfaceArea();
   }
 
-  auto Intersect(const Ray &ray, Intersection &intersection) const
-      -> bool override;
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool override;
+  void ComputeIntersection(const Ray &ray, const HitRecord &record,
+                           Intersection &intersection) const override;
+  auto IntersectP(const Ray &ray) const -> bool override;
   auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d &offset) override;
+  void BindMaterials(MaterialTable &materials) override;
   void Sample(Intersection &intersection, double &pdf) override;
   [[nodiscard]] auto HasEmission() const -> bool override;
   [[nodiscard]] auto GetSurfaceArea() const -> double override;
 
+  [[nodiscard]] auto MinCorner() const -> const math::Vector3d & {
+    return min_;
+  }
+  [[nodiscard]] auto MaxCorner() const -> const math::Vector3d & {
+    return max_;
+  }
+
  private:
+  auto HitDistance(const Ray &ray, double &t) const -> bool;
+
   math::Vector3d min_;
   math::Vector3d max_;
   double area_;
   std::shared_ptr<Material> material_;
+  MaterialId material_id_ = kNoMaterial;
 };
 }  // namespace cherry
 
@@ -30,18 +30,37 @@ class Plane final : public Object {
         std::shared_ptr<Material> material)
       : position_(position), normal_(normal), material_(std::move(material)) {}
 
-  auto Intersect(const Ray& ray, Intersection& intersection) const
-      -> bool override;
+  auto Intersect(const Ray& ray, HitRecord& record) const -> bool override;
+  void ComputeIntersection(const Ray& ray, const HitRecord& record,
+                           Intersection& intersection) const override;
+  auto IntersectP(const Ray& ray) const -> bool override;
   auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d& offset) override;
+  void BindMaterials(MaterialTable& materials) override;
+  auto ClipBounds(const Box& clip) -> Box override;
+  void AppendClipPoints(std::vector<math::Point3>& points) const override;
   void Sample(Intersection& intersection, double& pdf) override;
   [[nodiscard]] auto HasEmission() const -> bool override;
   [[nodiscard]] auto GetSurfaceArea() const -> double override;
 
+  [[nodiscard]] auto Position() const -> const math::Point3& {
+    return position_;
+  }
+  [[nodiscard]] auto Normal() const -> const math::Vector3d& {
+    return normal_;
+  }
+  // edges spanning the bounded plane, zero for an unbounded one
+  [[nodiscard]] auto E1() const -> const math::Vector3d& { return e1_; }
+  [[nodiscard]] auto E2() const -> const math::Vector3d& { return e2_; }
+
  private:
+  auto HitDistance(const Ray& ray, double& t) const -> bool;
+
   math::Vector3d e1_, e2_;
   math::Point3 position_;
   math::Vector3d normal_;
   std::shared_ptr<Material> material_;
+  MaterialId material_id_ = kNoMaterial;
 };
 }  // namespace cherry
 
@@ -21,15 +21,25 @@ class Sphere final : public Object {
          std::shared_ptr<Material> m)
       : material_(std::move(m)), center_(center), radius_(r), radius2_(r * r) {}
 
-  auto Intersect(const Ray &ray, Intersection &intersection) const
-      -> bool override;
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool override;
+  void ComputeIntersection(const Ray &ray, const HitRecord &record,
+                           Intersection &intersection) const override;
+  auto IntersectP(const Ray &ray) const -> bool override;
   auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d &offset) override;
+  void BindMaterials(MaterialTable &materials) override;
   void Sample(Intersection &intersection, double &pdf) override;
   [[nodiscard]] auto HasEmission() const -> bool override;
   [[nodiscard]] auto GetSurfaceArea() const -> double override;
 
+  [[nodiscard]] auto Center() const -> const math::Point3 & { return center_; }
+  [[nodiscard]] auto Radius2() const -> double { return radius2_; }
+
  private:
+  auto HitDistance(const Ray &ray, double &t) const -> bool;
+
   std::shared_ptr<Material> material_;
+  MaterialId material_id_ = kNoMaterial;
   math::Point3 center_;
   double radius_;
   double radius2_;
@@ -29,18 +29,29 @@ class Triangle final : public Object {
     normal_ = e1_.Cross(e2_).Normalized();
   }
 
-  auto Intersect(const Ray &ray, Intersection &intersection) const
-      -> bool override;
+  auto Intersect(const Ray &ray, HitRecord &record) const -> bool override;
+  void ComputeIntersection(const Ray &ray, const HitRecord &record,
+                           Intersection &intersection) const override;
+  auto IntersectP(const Ray &ray) const -> bool override;
   auto GetBounds() -> Box override;
+  void Translate(const math::Vector3d &offset) override;
+  void BindMaterials(MaterialTable &materials) override;
+  auto ClipBounds(const Box &clip) -> Box override;
+  void AppendClipPoints(std::vector<math::Point3> &points) const override;
   void Sample(Intersection &intersection, double &pdf) override;
   [[nodiscard]] auto HasEmission() const -> bool override;
   [[nodiscard]] auto GetSurfaceArea() const -> double override;
 
  private:
+  // b1 and b2 are the barycentric coordinates of the hit
+  auto HitDistance(const Ray &ray, double &t, double &b1, double &b2) const
+      -> bool;
+
   math::Point3 v0_, v1_, v2_;
   math::Point3 e1_, e2_;
   math::Vector3d normal_;
   std::shared_ptr<Material> material_ = nullptr;
+  MaterialId material_id_ = kNoMaterial;
 };
 }  // namespace cherry
 
@@ -27,6 +27,13 @@ constexpr double SQRT_INV_PI = 0.564189583547756286948079451561;
 constexpr double SQRT2_INV_PI = 0.797884560802865355879892119869;
 constexpr double EPSILON = 1e-5;
 constexpr double INF = 1.7976931348623157e+308;
+// bound on the relative error of rounding a real number to a double
+constexpr double MACHINE_EPSILON = 1.1102230246251565e-16;
+
+// bound on the relative error of n roundings in a row
+constexpr auto Gamma(int n) -> double {
+  return n * MACHINE_EPSILON / (1 - n * MACHINE_EPSILON);
+}
 }  // namespace cherry
 
 #endif  // !CHERRY_UTILITY_CONSTANT
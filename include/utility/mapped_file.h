@@ -0,0 +1,48 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : mapped_file.h
+// Author      : QRWells
+// Created at  : 2026/10/18 21:12
+// Description : Read-only memory mapping of a whole file
+
+#ifndef CHERRY_UTILITY_MAPPED_FILE
+#define CHERRY_UTILITY_MAPPED_FILE
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace cherry {
+/**
+ * @brief Maps a file read-only into the address space. Pages are loaded on
+ * first access and shared between every process mapping the same file.
+ */
+class MappedFile {
+ public:
+  MappedFile() = default;
+  // maps nothing if the file cannot be opened or is empty
+  explicit MappedFile(std::filesystem::path const& path);
+  ~MappedFile();
+
+  MappedFile(MappedFile const&) = delete;
+  auto operator=(MappedFile const&) -> MappedFile& = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+
+  [[nodiscard]] auto IsOpen() const -> bool { return data_ != nullptr; }
+  [[nodiscard]] auto Bytes() const -> std::span<std::byte const> {
+    return {data_, size_};
+  }
+
+ private:
+  void Unmap();
+
+  std::byte const* data_ = nullptr;
+  size_t size_ = 0;
+};
+}  // namespace cherry
+
+#endif  // !CHERRY_UTILITY_MAPPED_FILE
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : mesh_file.h
+// Author      : QRWells
+// Created at  : 2026/10/19 2:05
+// Description : Parallel readers of OBJ and PLY triangle meshes
+
+#ifndef CHERRY_UTILITY_MESH_FILE
+#define CHERRY_UTILITY_MESH_FILE
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "math/vector.h"
+
+namespace cherry {
+/**
+ * @brief Geometry of an indexed triangle mesh, three entries of vertex_index
+ * per triangle. normals and uvs are per vertex or empty.
+ */
+struct MeshData {
+  std::vector<math::Point3> positions;
+  std::vector<math::Vector3d> normals;
+  std::vector<math::Point2> uvs;
+  std::vector<uint32_t> vertex_index;
+};
+
+/**
+ * @brief Octahedral encoding of a unit normal in two 16-bit fixed-point
+ * coordinates, accurate to about 0.005 degrees
+ */
+inline auto PackNormal(math::Vector3d const& n) -> uint32_t {
+  auto const kNorm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if (!(kNorm > 0)) return 0;
+  auto u = n.x / kNorm;
+  auto v = n.y / kNorm;
+  if (n.z < 0) {
+    // the lower hemisphere folds over the diagonals of the square
+    auto const kU = u;
+    u = std::copysign(1.0 - std::abs(v), kU);
+    v = std::copysign(1.0 - std::abs(kU), v);
+  }
+  auto const kQuantize = [](double x) {
+    auto const kValue = std::lround(std::clamp(x, -1.0, 1.0) * 32767.0);
+    return static_cast<uint32_t>(static_cast<uint16_t>(kValue));
+  };
+  return kQuantize(u) | kQuantize(v) << 16;
+}
+
+inline auto UnpackNormal(uint32_t packed) -> math::Vector3d {
+  auto const kU = static_cast<int16_t>(packed & 0xffff) / 32767.0;
+  auto const kV = static_cast<int16_t>(packed >> 16) / 32767.0;
+  math::Vector3d n{kU, kV, 1.0 - std::abs(kU) - std::abs(kV)};
+  if (n.z < 0) {
+    n.x = std::copysign(1.0 - std::abs(kV), kU);
+    n.y = std::copysign(1.0 - std::abs(kU), kV);
+  }
+  return n.Normalized();
+}
+
+/**
+ * @brief Read the faces of an OBJ file, polygons are split into triangle
+ * fans. The file is mapped and parsed in parallel chunks that start at line
+ * boundaries: a first pass counts the vertex statements of every chunk so
+ * that the second one can resolve relative indices and write the vertices
+ * straight to their final place. Texture coordinates and normals are kept
+ * only when every corner has them, and corners are merged into shared
+ * vertices unless their attribute indices already agree.
+ *
+ * @return false if the file cannot be read or holds no face
+ */
+auto ReadObj(std::filesystem::path const& path, MeshData& mesh) -> bool;
+
+/**
+ * @brief Read the vertex and face elements of a binary PLY file, either byte
+ * order. Vertices are decoded in parallel, and so are the faces when all of
+ * them are triangles; other polygons are split into fans.
+ *
+ * @return false if the file cannot be read, is ASCII or holds no face
+ */
+auto ReadPly(std::filesystem::path const& path, MeshData& mesh) -> bool;
+}  // namespace cherry
+
+#endif  // !CHERRY_UTILITY_MESH_FILE
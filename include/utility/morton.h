@@ -0,0 +1,98 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : morton.h
+// Author      : QRWells
+// Created at  : 2026/10/18 23:58
+// Description : Morton codes and a parallel radix sort over them
+
+#ifndef CHERRY_UTILITY_MORTON
+#define CHERRY_UTILITY_MORTON
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "math/vector.h"
+
+namespace cherry {
+inline constexpr int kRadixBits = 8;
+inline constexpr int kRadixBuckets = 1 << kRadixBits;
+inline constexpr size_t kRadixChunkSize = size_t{1} << 12;
+
+// inserts two zero bits after each of the low 21 bits
+inline auto SpreadBits(uint64_t x) -> uint64_t {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffff;
+  x = (x | x << 16) & 0x1f0000ff0000ff;
+  x = (x | x << 8) & 0x100f00f00f00f00f;
+  x = (x | x << 4) & 0x10c30c30c30c30c3;
+  x = (x | x << 2) & 0x1249249249249249;
+  return x;
+}
+
+/**
+ * @brief Interleave the cells of offset on a grid of 2^bits cells per axis
+ *
+ * @param offset position in [0, 1]^3, values outside are clamped
+ * @param bits bits per axis, 21 at most
+ */
+inline auto MortonCode(math::Vector3d const& offset, int bits) -> uint64_t {
+  auto const kScale = static_cast<double>(1U << bits);
+  auto const kMax = (1U << bits) - 1;
+  std::array<uint64_t, 3> cell{};
+  for (int i = 0; i < 3; ++i)
+    cell[i] = std::min(static_cast<uint32_t>(std::max(offset[i], 0.0) * kScale),
+                       kMax);
+  return SpreadBits(cell[0]) << 2 | SpreadBits(cell[1]) << 1 |
+         SpreadBits(cell[2]);
+}
+
+/**
+ * @brief Stable LSD radix sort of values by the low bits of their code
+ * member, one taskloop per pass for the chunk histograms and one for the
+ * scatter. Runs on the team of the enclosing parallel region, if any.
+ */
+template <typename T>
+void RadixSort(std::vector<T>& values, int bits) {
+  std::vector<T> scratch(values.size());
+  auto const kChunks = static_cast<uint32_t>(
+      (values.size() + kRadixChunkSize - 1) / kRadixChunkSize);
+  std::vector<std::array<uint32_t, kRadixBuckets>> offsets(kChunks);
+  for (int shift = 0; shift < bits; shift += kRadixBits) {
+    auto const kDigit = [shift](T const& value) {
+      return (value.code >> shift) & (kRadixBuckets - 1);
+    };
+#pragma omp taskloop default(shared) grainsize(1)
+    for (uint32_t c = 0; c < kChunks; ++c) {
+      offsets[c].fill(0);
+      auto const kEnd = std::min(values.size(), (c + 1) * kRadixChunkSize);
+      for (auto i = c * kRadixChunkSize; i < kEnd; ++i)
+        ++offsets[c][kDigit(values[i])];
+    }
+
+    // bucket-major exclusive scan keeps equal digits in chunk order
+    uint32_t offset = 0;
+    for (int b = 0; b < kRadixBuckets; ++b) {
+      for (uint32_t c = 0; c < kChunks; ++c) {
+        auto const kSize = offsets[c][b];
+        offsets[c][b] = offset;
+        offset += kSize;
+      }
+    }
+
+#pragma omp taskloop default(shared) grainsize(1)
+    for (uint32_t c = 0; c < kChunks; ++c) {
+      auto const kEnd = std::min(values.size(), (c + 1) * kRadixChunkSize);
+      for (auto i = c * kRadixChunkSize; i < kEnd; ++i)
+        scratch[offsets[c][kDigit(values[i])]++] = values[i];
+    }
+    values.swap(scratch);
+  }
+}
+}  // namespace cherry
+
+#endif  // !CHERRY_UTILITY_MORTON
@@ -12,6 +12,7 @@
 #include <utility>
 
 #include "integrator/normal_integrator.h"
+#include "integrator/wavefront_integrator.h"
 
 using namespace std;
 using namespace cherry;
@@ -26,6 +27,17 @@ struct CliOptions {
   string output = "binary";
   int threads = 0;
   string size;
+  BvhBuildOptions bvh;
+  string bvh_layout = "binary";
+  string bvh_quality = "fast";
+  string bvh_cache;
+  string bvh_node_order = "depth-first";
+  string mesh;
+  // convert subcommand
+  string convert_input;
+  string convert_output;
+  bool pack_normals = false;
+  WavefrontOptions wavefront;
 };
 
 auto StripPpmSuffix(string value) -> string {
@@ -75,11 +87,50 @@ auto ParseSizeWxH(string const& value, int& width, int& height) -> bool {
   return true;
 }
 
-auto MakeIntegrator(string const& name) -> shared_ptr<Integrator> {
+auto MakeIntegrator(CliOptions const& opts) -> shared_ptr<Integrator> {
+  auto const& name = opts.integrator;
   if (name == "normal") return make_shared<NormalIntegrator>();
+  if (name == "wavefront")
+    return make_shared<WavefrontIntegrator>(opts.wavefront);
   return make_shared<PathIntegrator>();
 }
 
+auto ParseBvhLayout(string const& name) -> BvhLayout {
+  if (name == "bvh4") return BvhLayout::kWide4;
+  if (name == "bvh8") return BvhLayout::kWide8;
+  if (name == "cbvh4") return BvhLayout::kCompressed4;
+  if (name == "cbvh8") return BvhLayout::kCompressed8;
+  return BvhLayout::kBinary;
+}
+
+auto ParseBvhNodeOrder(string const& name) -> BvhNodeOrder {
+  if (name == "treelets") return BvhNodeOrder::kTreelets;
+  return BvhNodeOrder::kDepthFirst;
+}
+
+auto ParseBvhQuality(string const& name) -> BvhBuildQuality {
+  if (name == "preview") return BvhBuildQuality::kPreview;
+  if (name == "high") return BvhBuildQuality::kHigh;
+  return BvhBuildQuality::kFast;
+}
+
+// writes the mesh of an OBJ or PLY file as a Cherry mesh file
+auto ConvertMesh(CliOptions const& opts) -> int {
+  Mesh mesh(nullptr);
+  if (!mesh.Load(opts.convert_input)) {
+    cerr << "error: no triangle could be read from " << opts.convert_input
+         << '\n';
+    return 1;
+  }
+  if (!mesh.SaveBinary(opts.convert_output, opts.pack_normals)) {
+    cerr << "error: unable to write " << opts.convert_output << '\n';
+    return 1;
+  }
+  cout << mesh.TriangleCount() << " triangles, " << mesh.VertexCount()
+       << " vertices written to " << opts.convert_output << '\n';
+  return 0;
+}
+
 auto MakeDefaultScene(double aspect_ratio) -> shared_ptr<Scene> {
   // create camera
   auto camera =
@@ -159,11 +210,73 @@ auto main(int argc, char** argv) -> int {
   app.add_option("--size", opts.size, "Image size as WxH, e.g. 800x600");
   app.add_option("--spp", opts.spp, "Samples per pixel")
       ->check(CLI::Range(1, std::numeric_limits<int>::max()));
-  app.add_option("--integrator", opts.integrator, "Integrator: path|normal")
-      ->check(CLI::IsMember({"path", "normal"}));
+  app.add_option("--integrator", opts.integrator,
+                 "Integrator: path|normal|wavefront")
+      ->check(CLI::IsMember({"path", "normal", "wavefront"}));
+  app.add_flag("--sort-rays", opts.wavefront.sort_rays,
+               "Wavefront integrator: bin secondary and shadow rays by "
+               "direction and origin before tracing them");
   app.add_option("-o,--output", opts.output,
                  "Output file base name/path (without .ppm)")
       ->capture_default_str();
+  app.add_option("--mesh", opts.mesh,
+                 "OBJ, binary PLY or Cherry (.cmesh) mesh added to the scene "
+                 "in its own coordinates")
+      ->check(CLI::ExistingFile);
+  app.add_option("--bvh-leaf-size", opts.bvh.max_leaf_size,
+                 "Maximum number of primitives in a BVH leaf")
+      ->check(CLI::Range(1U, BvhBuildOptions::kMaxLeafSize))
+      ->capture_default_str();
+  app.add_option("--bvh-leaf-batch", opts.bvh.leaf_batch_size,
+                 "Primitives a BVH leaf tests together; the SIMD width (2 "
+                 "with SSE2, 4 with AVX) and a larger leaf size suit scenes "
+                 "of many spheres, boxes or planes")
+      ->check(CLI::Range(1U, BvhBuildOptions::kMaxLeafSize))
+      ->capture_default_str();
+  app.add_option("--bvh-traversal-cost", opts.bvh.traversal_cost,
+                 "SAH cost of visiting a BVH node")
+      ->check(CLI::PositiveNumber)
+      ->capture_default_str();
+  app.add_option("--bvh-intersection-cost", opts.bvh.intersection_cost,
+                 "SAH cost of testing a primitive")
+      ->check(CLI::PositiveNumber)
+      ->capture_default_str();
+  app.add_option("--bvh-quality", opts.bvh_quality,
+                 "BVH build quality: preview (LBVH)|fast|high (spatial splits)")
+      ->check(CLI::IsMember({"preview", "fast", "high"}))
+      ->capture_default_str();
+  app.add_option("--bvh-split-budget", opts.bvh.split_budget,
+                 "References spatial splits may add, relative to the "
+                 "primitive count")
+      ->check(CLI::NonNegativeNumber)
+      ->capture_default_str();
+  app.add_option("--bvh-layout", opts.bvh_layout,
+                 "BVH node layout: binary|bvh4|bvh8, or cbvh4|cbvh8 with "
+                 "quantized bounds")
+      ->check(CLI::IsMember({"binary", "bvh4", "bvh8", "cbvh4", "cbvh8"}))
+      ->capture_default_str();
+  app.add_option("--bvh-node-order", opts.bvh_node_order,
+                 "Memory order of the binary BVH nodes: depth-first|treelets "
+                 "(page-sized treelets of the most visited nodes)")
+      ->check(CLI::IsMember({"depth-first", "treelets"}))
+      ->capture_default_str();
+  app.add_option("--bvh-profile-rays", opts.bvh.treelet_profile_rays,
+                 "Camera rays traced to weight the BVH treelets by measured "
+                 "node visits, 0 estimates them from surface areas")
+      ->capture_default_str();
+  app.add_option("--bvh-cache", opts.bvh_cache,
+                 "File the BVH is loaded from when it was built for the same "
+                 "scene and options, and saved to otherwise");
+  auto* convert = app.add_subcommand(
+      "convert", "Write an OBJ or PLY mesh with its BVH as a .cmesh file");
+  convert->add_option("input", opts.convert_input, "OBJ or PLY file")
+      ->required()
+      ->check(CLI::ExistingFile);
+  convert->add_option("output", opts.convert_output, "Cherry mesh file")
+      ->required();
+  convert->add_flag("--pack-normals", opts.pack_normals,
+                    "Store normals in 32 bits (octahedral) instead of 24 "
+                    "bytes");
   auto* threads_opt =
       app.add_option("--threads", opts.threads, "OpenMP thread count")
           ->check(CLI::Range(1, std::numeric_limits<int>::max()));
@@ -179,6 +292,10 @@ auto main(int argc, char** argv) -> int {
       }
     }
 
+    opts.bvh.layout = ParseBvhLayout(opts.bvh_layout);
+    opts.bvh.quality = ParseBvhQuality(opts.bvh_quality);
+    opts.bvh.node_order = ParseBvhNodeOrder(opts.bvh_node_order);
+    opts.bvh.cache_file = opts.bvh_cache;
     opts.output = StripPpmSuffix(std::move(opts.output));
     if (opts.output.empty()) {
       throw CLI::ValidationError("--output", "Output must not be empty");
@@ -196,16 +313,27 @@ auto main(int argc, char** argv) -> int {
 #endif
   }
 
+  if (convert->parsed()) return ConvertMesh(opts);
+
   auto const width = static_cast<uint32_t>(opts.width);
   auto const height = static_cast<uint32_t>(opts.height);
   auto const aspect_ratio =
       static_cast<double>(width) / static_cast<double>(height);
 
   auto const scene = MakeDefaultScene(aspect_ratio);
-  auto const integrator = MakeIntegrator(opts.integrator);
+  if (!opts.mesh.empty()) {
+    auto mesh = make_shared<Mesh>(
+        make_shared<DiffuseMaterial>(Point3{0.725, 0.71, 0.68}));
+    if (!mesh->Load(opts.mesh)) {
+      cerr << "error: no triangle could be read from " << opts.mesh << '\n';
+      return 1;
+    }
+    scene->Add(mesh);
+  }
+  auto const integrator = MakeIntegrator(opts);
 
   auto renderer = RayTracer(scene, width, height, integrator,
-                            static_cast<size_t>(opts.spp));
+                            static_cast<size_t>(opts.spp), opts.bvh);
   renderer.Render();
   renderer.SavePpm(opts.output);
 
@@ -8,126 +8,358 @@
 // Created at  : 2021/08/24 5:48
 // Description :
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <utility>
 
 #include "acceleration/bvh.h"
 #include "common/box.h"
 
 namespace cherry {
-void Bvh::Construct(std::vector<std::shared_ptr<Object>> const& objects) {
-  root_ = Build(objects);
+namespace {
+// object(i) is the i-th of count objects to build over
+template <typename Lookup>
+auto MakeReferences(size_t count, Lookup const& object)
+    -> std::vector<BvhPrimitive> {
+  auto const kCount = static_cast<int64_t>(count);
+  std::vector<BvhPrimitive> references(count);
+#pragma omp parallel for
+  for (int64_t i = 0; i < kCount; ++i) {
+    auto& reference = references[i];
+    reference.bounds = object(static_cast<uint32_t>(i)).GetBounds();
+    reference.centroid = reference.bounds.Centroid();
+    reference.index = static_cast<uint32_t>(i);
+  }
+  return references;
 }
 
-auto Bvh::Intersect(Ray const& ray, Intersection& intersection) const -> bool {
-  if (root_ == nullptr) return false;
-  return GetIntersection(ray, root_, intersection);
-}
-
-auto Bvh::Build(std::vector<std::shared_ptr<Object>> const& objects)
-    -> std::shared_ptr<BvhNode> {
-  auto node = std::make_shared<BvhNode>();
-
-  Box bound;
-  for (auto const& k_o : objects) bound = bound.Union(k_o->GetBounds());
-  std::vector<std::shared_ptr<Object>> left_shapes;
-  std::vector<std::shared_ptr<Object>> right_shapes;
-  switch (objects.size()) {
-    case 1:
-      node->bounds = objects[0]->GetBounds();
-      node->object = objects[0];
-      node->left = nullptr;
-      node->right = nullptr;
-      node->area = objects[0]->GetSurfaceArea();
-      return node;
-    case 2:
-      node->left = Build(std::vector{objects[0]});
-      node->right = Build(std::vector{objects[1]});
-      node->bounds = node->left->bounds.Union(node->right->bounds);
-      node->area = node->bounds.SurfaceArea();
-      return node;
-      [[likely]] default : Box centroid;
-      for (auto const& k_o : objects)
-        centroid = centroid.Union(Box(k_o->GetBounds().Centroid()));
-      auto total_area = centroid.SurfaceArea();
-      size_t min_cost_coords = 0;
-      size_t min_cost_index = 0;
-      auto min_cost = std::numeric_limits<double>::infinity();
-      std::map<size_t, std::map<size_t, size_t>> index_map;
-      for (int i = 0; i < 3; i++) {
-        int constexpr kBucketCount = 12;
-        std::vector<Box> bounds_buckets;
-        std::vector<int> count_bucket;
-        for (int j = 0; j < kBucketCount; j++) {
-          bounds_buckets.emplace_back();
-          count_bucket.push_back(0);
-        }
-
-        std::map<size_t, size_t> obj_map;
-
-        for (size_t j = 0; j < objects.size(); j++) {
-          int bid = kBucketCount * static_cast<int>(centroid.Offset(
-                                       objects[j]->GetBounds().Centroid())[i]);
-          if (bid > kBucketCount - 1) bid = kBucketCount - 1;
-
-          Box b = bounds_buckets[bid];
-          b = b.Union(Box(objects[j]->GetBounds().Centroid()));
-          bounds_buckets[bid] = b;
-          count_bucket[bid] = count_bucket[bid] + 1;
-          obj_map.insert({j, bid});
-        }
-
-        index_map.emplace(i, obj_map);
-
-        for (size_t j = 1; j < bounds_buckets.size(); j++) {
-          Box a;
-          Box b;
-          int count_a = 0;
-          int count_b = 0;
-          for (size_t k = 0; k < j; k++) {
-            a = a.Union(bounds_buckets[k]);
-            count_a += count_bucket[k];
-          }
-
-          for (size_t k = j; k < bounds_buckets.size(); k++) {
-            b = b.Union(bounds_buckets[k]);
-            count_b += count_bucket[k];
-          }
-
-          if (auto cost =
-                  (count_a * a.SurfaceArea() + count_b * b.SurfaceArea()) /
-                  total_area;
-              cost < min_cost) {
-            min_cost = cost;
-            min_cost_index = j;
-            min_cost_coords = i;
-          }
-        }
+template <typename Lookup>
+auto MakeClipFunction(Lookup object) -> BvhClipFunction {
+  return [object](uint32_t index, Box const& clip) {
+    return object(index).ClipBounds(clip);
+  };
+}
+
+// area of a relative to b, guarded against empty and unbounded boxes
+auto AreaRatio(Box const& a, Box const& b) -> double {
+  auto const kArea = b.SurfaceArea();
+  if (!(kArea > 0) || !std::isfinite(kArea)) return 1.0;
+  return a.SurfaceArea() / kArea;
+}
+}  // namespace
+
+void Bvh::Construct(std::vector<std::shared_ptr<Object>> const& objects,
+                    BvhBuildOptions const& options,
+                    std::span<Ray const> profile_rays) {
+  options_ = options;
+  nodes_.clear();
+  std::apply([](auto&... arrays) { (arrays.nodes.clear(), ...); },
+             wide_nodes_);
+  primitives_.clear();
+  build_costs_.clear();
+  mapping_.reset();
+  if (objects.empty()) return;
+
+  auto const kUseCache = !options_.cache_file.empty();
+  auto const kKey = kUseCache ? CacheKey(objects, options_) : 0;
+  std::vector<uint32_t> slots;
+  if (kUseCache && LoadCache(objects, kKey, slots)) {
+    SetPrimitives(objects, slots);
+    return;
+  }
+
+  auto const kObject = [&objects](uint32_t i) -> Object& {
+    return *objects[i];
+  };
+  BvhBuilder builder(MakeReferences(objects.size(), kObject), options_,
+                     MakeClipFunction(kObject));
+  auto const kRoot = builder.Build();
+
+  nodes_.resize(builder.NodeCount());
+  uint32_t offset = 0;
+  Flatten(*kRoot, 0, offset);
+  slots.reserve(builder.Primitives().size());
+  for (auto const& reference : builder.Primitives())
+    slots.push_back(reference.index);
+  SetPrimitives(objects, slots);
+
+  ComputeCosts(build_costs_);
+  CollapseLayout();
+  if (options_.node_order == BvhNodeOrder::kTreelets)
+    LayOutTreelets(profile_rays.empty() ? AreaWeights()
+                                        : CountVisits(profile_rays));
+  if (kUseCache) SaveCache(builder.Primitives(), kKey);
+}
+
+void Bvh::Refit(std::vector<std::shared_ptr<Object>> const& objects) {
+  if (Nodes().empty()) return;
+  Detach();
+  store_.Update(objects);
+
+  auto const kCount = static_cast<int64_t>(nodes_.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (int64_t i = 0; i < kCount; ++i) {
+    auto& node = nodes_[i];
+    if (node.primitive_count == 0) continue;
+    node.bounds = store_.Get(primitives_[node.primitives_offset]).GetBounds();
+    for (uint32_t j = 1; j < node.primitive_count; ++j)
+      node.bounds = node.bounds.Union(
+          store_.Get(primitives_[node.primitives_offset + j]).GetBounds());
+  }
+  // children always follow their parent, so a reverse sweep is bottom-up
+  for (auto i = kCount - 1; i >= 0; --i) {
+    auto& node = nodes_[i];
+    if (node.primitive_count > 0) continue;
+    node.bounds = nodes_[node.first_child_offset].bounds.Union(
+        nodes_[node.second_child_offset].bounds);
+  }
+
+  std::vector<double> costs;
+  ComputeCosts(costs);
+  auto const kDegraded = [&](uint32_t i) {
+    return costs[i] > options_.rebuild_threshold * build_costs_[i];
+  };
+  if (kDegraded(0)) {
+    // the rebuilt subtree is spliced into the depth-first array
+    if (options_.node_order != BvhNodeOrder::kDepthFirst) {
+      RestoreDepthFirst();
+      ComputeCosts(costs);
+    }
+    // follow the degradation down while it is confined to one child
+    uint32_t index = 0;
+    while (nodes_[index].primitive_count == 0) {
+      auto const kLeft = nodes_[index].first_child_offset;
+      auto const kRight = nodes_[index].second_child_offset;
+      if (kDegraded(kLeft) == kDegraded(kRight)) break;
+      index = kDegraded(kLeft) ? kLeft : kRight;
+    }
+    RebuildSubtree(index);
+    ComputeCosts(build_costs_);
+    if (options_.node_order == BvhNodeOrder::kTreelets)
+      LayOutTreelets(AreaWeights());
+  }
+  blocks_.Build(store_, primitives_);
+  CollapseLayout();
+}
+
+auto Bvh::Cost() const -> double {
+  if (Nodes().empty()) return 0.0;
+  std::vector<double> costs;
+  ComputeCosts(costs);
+  return costs[0];
+}
+
+void Bvh::ComputeCosts(std::vector<double>& costs) const {
+  auto const kNodes = Nodes();
+  // leaves are charged per batch they test, like BvhBuilder::LeafIsCheaper
+  auto const kBatchSize = std::max(options_.leaf_batch_size, 1U);
+  costs.resize(kNodes.size());
+  for (auto i = static_cast<int64_t>(kNodes.size()) - 1; i >= 0; --i) {
+    auto const& node = kNodes[i];
+    if (node.primitive_count > 0) {
+      costs[i] = options_.intersection_cost *
+                 ((node.primitive_count + kBatchSize - 1) / kBatchSize);
+      continue;
+    }
+    auto const kLeft = node.first_child_offset;
+    auto const kRight = node.second_child_offset;
+    costs[i] = options_.traversal_cost +
+               AreaRatio(kNodes[kLeft].bounds, node.bounds) * costs[kLeft] +
+               AreaRatio(kNodes[kRight].bounds, node.bounds) * costs[kRight];
+  }
+}
+
+void Bvh::RebuildSubtree(uint32_t index) {
+  auto const kNodeEnd = SubtreeEnd(index);
+  auto const [kFirst, kLast] = PrimitiveRange(index);
+
+  // spatial splits may have referenced a primitive from several leaves
+  std::vector<PrimitiveRef> refs(primitives_.begin() + kFirst,
+                                 primitives_.begin() + kLast);
+  std::sort(refs.begin(), refs.end());
+  refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+
+  auto const kObject = [this, &refs](uint32_t i) -> Object& {
+    return store_.Get(refs[i]);
+  };
+  BvhBuilder builder(MakeReferences(refs.size(), kObject), options_,
+                     MakeClipFunction(kObject));
+  auto const kRoot = builder.Build(Depth(index));
+  auto const kNodeDelta = static_cast<int64_t>(builder.NodeCount()) -
+                          static_cast<int64_t>(kNodeEnd - index);
+  auto const kPrimitiveDelta =
+      static_cast<int64_t>(builder.Primitives().size()) -
+      static_cast<int64_t>(kLast - kFirst);
+
+  // shift whatever lies behind the subtree, then splice the new one in
+  auto const kShift = [&](uint32_t begin, uint32_t end) {
+    for (auto i = begin; i < end; ++i) {
+      auto& node = nodes_[i];
+      for (auto* const kChild :
+           {&node.first_child_offset, &node.second_child_offset}) {
+        if (node.primitive_count == 0 && *kChild >= kNodeEnd)
+          *kChild = static_cast<uint32_t>(*kChild + kNodeDelta);
       }
+      if (node.primitive_count > 0 && node.primitives_offset >= kLast)
+        node.primitives_offset =
+            static_cast<uint32_t>(node.primitives_offset + kPrimitiveDelta);
+    }
+  };
+  kShift(0, index);
+  kShift(kNodeEnd, static_cast<uint32_t>(nodes_.size()));
+  nodes_.erase(nodes_.begin() + index, nodes_.begin() + kNodeEnd);
+  nodes_.insert(nodes_.begin() + index, builder.NodeCount(), LinearBvhNode{});
+  primitives_.erase(primitives_.begin() + kFirst, primitives_.begin() + kLast);
+  std::vector<PrimitiveRef> ordered;
+  ordered.reserve(builder.Primitives().size());
+  for (auto const& reference : builder.Primitives())
+    ordered.push_back(refs[reference.index]);
+  primitives_.insert(primitives_.begin() + kFirst, ordered.begin(),
+                     ordered.end());
+
+  auto offset = index;
+  Flatten(*kRoot, kFirst, offset);
+  SortLeaves(index, offset);
+}
 
-      for (size_t i = 0; i < objects.size(); i++)
-        if (index_map[min_cost_coords][i] < min_cost_index)
-          left_shapes.push_back(objects[i]);
-        else
-          right_shapes.push_back(objects[i]);
-      break;
+void Bvh::CollapseLayout() {
+  VisitWideNodes(*this, [this](auto& array) { Collapse(array.nodes); });
+}
+
+auto Bvh::Depth(uint32_t index) const -> int {
+  // children follow their parent, the second one after the whole first
+  // subtree
+  int depth = 0;
+  for (uint32_t current = 0; current != index; ++depth) {
+    auto const& node = nodes_[current];
+    current = index >= node.second_child_offset ? node.second_child_offset
+                                                : node.first_child_offset;
+  }
+  return depth;
+}
+
+auto Bvh::SubtreeEnd(uint32_t index) const -> uint32_t {
+  while (nodes_[index].primitive_count == 0)
+    index = nodes_[index].second_child_offset;
+  return index + 1;
+}
+
+auto Bvh::PrimitiveRange(uint32_t index) const
+    -> std::pair<uint32_t, uint32_t> {
+  auto first = index;
+  while (nodes_[first].primitive_count == 0) ++first;
+  auto const kLast = SubtreeEnd(index) - 1;
+  return {nodes_[first].primitives_offset,
+          nodes_[kLast].primitives_offset + nodes_[kLast].primitive_count};
+}
+
+auto Bvh::Intersect(Ray const& ray, Intersection& intersection) const -> bool {
+  HitRecord record;
+  if (!Intersect(ray, record)) return false;
+  FillIntersection(ray, record, intersection);
+  return true;
+}
+
+auto Bvh::Intersect(Ray const& ray, HitRecord& record) const -> bool {
+  if (Nodes().empty()) return false;
+  switch (options_.layout) {
+    case BvhLayout::kWide4:
+      return IntersectWide(WideNodes<WideBvhNode<4>>(), ray, record);
+    case BvhLayout::kWide8:
+      return IntersectWide(WideNodes<WideBvhNode<8>>(), ray, record);
+    case BvhLayout::kCompressed4:
+      return IntersectWide(WideNodes<CompressedBvhNode<4>>(), ray, record);
+    case BvhLayout::kCompressed8:
+      return IntersectWide(WideNodes<CompressedBvhNode<8>>(), ray, record);
+    default:
+      return IntersectBinary(ray, record);
+  }
+}
+
+auto Bvh::IntersectAny(Ray const& ray) const -> bool {
+  if (Nodes().empty()) return false;
+  switch (options_.layout) {
+    case BvhLayout::kWide4:
+      return IntersectAnyWide(WideNodes<WideBvhNode<4>>(), ray);
+    case BvhLayout::kWide8:
+      return IntersectAnyWide(WideNodes<WideBvhNode<8>>(), ray);
+    case BvhLayout::kCompressed4:
+      return IntersectAnyWide(WideNodes<CompressedBvhNode<4>>(), ray);
+    case BvhLayout::kCompressed8:
+      return IntersectAnyWide(WideNodes<CompressedBvhNode<8>>(), ray);
+    default:
+      return IntersectAnyBinary(ray);
   }
-  node->left = Build(left_shapes);
-  node->right = Build(right_shapes);
-  node->bounds = node->left->bounds.Union(node->right->bounds);
-
-  return node;
-}
-auto Bvh::GetIntersection(Ray const& ray, const std::shared_ptr<BvhNode>& node,
-                          Intersection& intersection) -> bool {
-  if (node == nullptr) return false;
-  if (node->left == nullptr && node->right == nullptr)
-    return node->object->Intersect(ray, intersection);
-
-  Intersection inter1;
-  Intersection inter2;
-  auto const kI1 = GetIntersection(ray, node->left, inter1);
-  auto const kI2 = GetIntersection(ray, node->right, inter2);
-  intersection = inter1.distance < inter2.distance ? inter1 : inter2;
-  return kI1 || kI2;
-}
-}  // namespace cherry
\ No newline at end of file
+}
+
+auto Bvh::IntersectBinary(Ray const& ray, HitRecord& record,
+                          uint32_t root) const -> bool {
+  // the local copy shrinks its t_max with every hit so that farther
+  // subtrees are culled by the slab test
+  Ray closest = ray;
+  bool hit = false;
+  TraverseBinary(Nodes(), root, closest, true,
+                 [&](LinearBvhNode const& node) {
+                   hit |= IntersectLeaf(node.primitives_offset,
+                                        node.primitive_count, closest, record);
+                   return false;
+                 });
+  return hit;
+}
+
+auto Bvh::IntersectAnyBinary(Ray const& ray, uint32_t root) const -> bool {
+  return TraverseBinary(Nodes(), root, ray, false,
+                        [&](LinearBvhNode const& node) {
+                          return IntersectLeafAny(node.primitives_offset,
+                                                  node.primitive_count, ray);
+                        });
+}
+
+void Bvh::BindMaterials(MaterialTable& materials) {
+  store_.BindMaterials(materials);
+}
+
+void Bvh::SetPrimitives(std::vector<std::shared_ptr<Object>> const& objects,
+                        std::span<uint32_t const> slots) {
+  store_.Build(objects, slots);
+  primitives_.resize(slots.size());
+  for (size_t i = 0; i < slots.size(); ++i)
+    primitives_[i] = store_.Ref(slots[i]);
+  SortLeaves(0, static_cast<uint32_t>(Nodes().size()));
+  blocks_.Build(store_, primitives_);
+}
+
+void Bvh::SortLeaves(uint32_t begin, uint32_t end) {
+  auto const kNodes = Nodes();
+  for (auto i = begin; i < end; ++i) {
+    auto const& node = kNodes[i];
+    if (node.primitive_count == 0) continue;
+    auto const kFirst = primitives_.begin() + node.primitives_offset;
+    std::stable_sort(kFirst, kFirst + node.primitive_count,
+                     [](auto const& a, auto const& b) {
+                       return a.kind < b.kind;
+                     });
+  }
+}
+
+auto Bvh::Flatten(BvhBuildNode const& node, uint32_t primitive_base,
+                  uint32_t& offset) -> uint32_t {
+  auto const kIndex = offset++;
+  auto& linear = nodes_[kIndex];
+  linear.bounds = node.bounds;
+  linear.axis = node.axis;
+  if (node.children[0] == nullptr) {
+    linear.primitives_offset = primitive_base + node.first_primitive;
+    linear.primitive_count = static_cast<uint16_t>(node.primitive_count);
+  } else {
+    linear.primitive_count = 0;
+    nodes_[kIndex].first_child_offset =
+        Flatten(*node.children[0], primitive_base, offset);
+    nodes_[kIndex].second_child_offset =
+        Flatten(*node.children[1], primitive_base, offset);
+  }
+  return kIndex;
+}
+}  // namespace cherry
@@ -0,0 +1,709 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : bvh_builder.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 14:02
+// Description :
+
+#include "acceleration/bvh_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "utility/morton.h"
+
+namespace cherry {
+namespace {
+// ranges larger than this are binned by several tasks in parallel
+constexpr uint32_t kParallelBinThreshold = 1U << 14;
+constexpr uint32_t kChunkSize = 1U << 12;
+// subtrees larger than this are handed off as a separate task
+constexpr uint32_t kTaskThreshold = 1U << 12;
+// past this depth the builder only does median splits, which keeps the tree
+// within the kMaxBvhDepth of the traversal stacks
+constexpr int kMaxSahDepth = 32;
+// overlap of the object split children, relative to the root surface area,
+// above which a spatial split is considered
+constexpr double kSpatialSplitAlpha = 1e-5;
+
+// below this count 30-bit Morton codes (10 bits per axis) are precise
+// enough, above it 63-bit codes are used
+constexpr uint32_t kSmallMortonCount = 1U << 20;
+// primitives sharing this many leading Morton bits form one treelet
+constexpr int kTreeletBits = 12;
+
+struct MortonPrimitive {
+  uint64_t code;
+  uint32_t index;
+};
+
+auto ChunkCount(size_t count) -> uint32_t {
+  return static_cast<uint32_t>((count + kChunkSize - 1) / kChunkSize);
+}
+}  // namespace
+
+void BvhBuilder::Bucket::Add(Box const& box) {
+  bounds = count == 0 ? box : bounds.Union(box);
+  ++count;
+}
+
+void BvhBuilder::Bucket::Merge(Bucket const& bucket) {
+  if (bucket.count == 0) return;
+  bounds = count == 0 ? bucket.bounds : bounds.Union(bucket.bounds);
+  count += bucket.count;
+}
+
+BvhBuilder::BvhBuilder(std::vector<BvhPrimitive> primitives,
+                       BvhBuildOptions const& options, BvhClipFunction clip)
+    : primitives_(std::move(primitives)),
+      options_(options),
+      clip_(std::move(clip)) {
+  options_.max_leaf_size =
+      std::clamp(options_.max_leaf_size, 1U, BvhBuildOptions::kMaxLeafSize);
+}
+
+auto BvhBuilder::Build(int depth) -> std::unique_ptr<BvhBuildNode> {
+  node_count_ = 0;
+  if (primitives_.empty()) return nullptr;
+
+  std::unique_ptr<BvhBuildNode> root;
+  auto const kCount = static_cast<uint32_t>(primitives_.size());
+  if (options_.quality == BvhBuildQuality::kFast) {
+#pragma omp parallel
+#pragma omp single
+    root = BuildRange(0, kCount, depth);
+    return root;
+  }
+  if (options_.quality == BvhBuildQuality::kPreview) {
+#pragma omp parallel
+#pragma omp single
+    root = BuildMorton(depth);
+    morton_codes_ = {};
+    return root;
+  }
+
+  Box bounds;
+  Box centroid_bounds;
+  ComputeBounds(primitives_, bounds, centroid_bounds);
+  root_area_ = bounds.SurfaceArea();
+  split_budget_ = static_cast<int64_t>(
+      std::max(options_.split_budget, 0.0) * static_cast<double>(kCount));
+#pragma omp parallel
+#pragma omp single
+  root = BuildSpatial(std::move(primitives_), depth);
+
+  // lay the leaf references out in depth-first order
+  primitives_.clear();
+  Gather(*root);
+  return root;
+}
+
+auto BvhBuilder::BuildRange(uint32_t begin, uint32_t end, int depth)
+    -> std::unique_ptr<BvhBuildNode> {
+  auto const kCount = end - begin;
+  auto const kReferences =
+      References(primitives_).subspan(begin, static_cast<size_t>(kCount));
+  Box bounds;
+  Box centroid_bounds;
+  ComputeBounds(kReferences, bounds, centroid_bounds);
+
+  auto const kFitsLeaf = kCount <= options_.max_leaf_size;
+  if (kCount == 1) return MakeLeaf(begin, end, bounds);
+
+  auto const kFirst = primitives_.begin() + begin;
+  auto const kLast = primitives_.begin() + end;
+  auto axis = centroid_bounds.MaxExtent();
+  auto mid = begin;
+
+  if (centroid_bounds.max[axis] <= centroid_bounds.min[axis] ||
+      depth >= kMaxSahDepth) {
+    if (kFitsLeaf) return MakeLeaf(begin, end, bounds);
+  } else {
+    auto const kSplit = FindObjectSplit(kReferences, centroid_bounds);
+    axis = kSplit.axis;
+
+    // a leaf is kept whenever it is no more expensive than the best split
+    if (kFitsLeaf && LeafIsCheaper(kCount, kSplit.cost, bounds))
+      return MakeLeaf(begin, end, bounds);
+
+    if (kSplit.bucket > 0) {
+      auto const kMid = std::partition(
+          kFirst, kLast, [&](BvhPrimitive const& primitive) {
+            return BucketIndex(primitive, axis, centroid_bounds) <
+                   kSplit.bucket;
+          });
+      mid = static_cast<uint32_t>(kMid - primitives_.begin());
+    }
+  }
+
+  if (mid == begin || mid == end) {
+    // no usable SAH split, fall back to the centroid median
+    mid = begin + kCount / 2;
+    std::nth_element(kFirst, primitives_.begin() + mid, kLast,
+                     [axis](BvhPrimitive const& a, BvhPrimitive const& b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+  }
+
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->bounds = bounds;
+  node->axis = static_cast<uint8_t>(axis);
+
+  auto* const kNode = node.get();
+  if (kCount > kTaskThreshold) {
+#pragma omp task firstprivate(kNode, begin, mid, depth)
+    kNode->children[0] = BuildRange(begin, mid, depth + 1);
+    kNode->children[1] = BuildRange(mid, end, depth + 1);
+#pragma omp taskwait
+  } else {
+    kNode->children[0] = BuildRange(begin, mid, depth + 1);
+    kNode->children[1] = BuildRange(mid, end, depth + 1);
+  }
+  return node;
+}
+
+auto BvhBuilder::BuildSpatial(std::vector<BvhPrimitive> references, int depth)
+    -> std::unique_ptr<BvhBuildNode> {
+  Box bounds;
+  Box centroid_bounds;
+  ComputeBounds(references, bounds, centroid_bounds);
+
+  auto const kCount = static_cast<uint32_t>(references.size());
+  auto const kFitsLeaf = kCount <= options_.max_leaf_size;
+  if (kCount == 1) return MakeLeaf(std::move(references), bounds);
+
+  auto axis = centroid_bounds.MaxExtent();
+  std::vector<BvhPrimitive> left;
+  std::vector<BvhPrimitive> right;
+
+  if (centroid_bounds.max[axis] <= centroid_bounds.min[axis] ||
+      depth >= kMaxSahDepth) {
+    if (kFitsLeaf) return MakeLeaf(std::move(references), bounds);
+  } else {
+    auto const kObject = FindObjectSplit(references, centroid_bounds);
+    SpatialSplit spatial{std::numeric_limits<double>::infinity(), 0, 0, {}, {}};
+    auto const kOverlap = kObject.left.bounds.Clip(kObject.right.bounds);
+    if ((kObject.bucket == 0 ||
+         (!kOverlap.Empty() &&
+          kOverlap.SurfaceArea() > kSpatialSplitAlpha * root_area_)) &&
+        split_budget_.load(std::memory_order_relaxed) > 0)
+      spatial = FindSpatialSplit(references, bounds);
+
+    if (kFitsLeaf &&
+        LeafIsCheaper(kCount, std::min(kObject.cost, spatial.cost), bounds))
+      return MakeLeaf(std::move(references), bounds);
+
+    if (spatial.cost < kObject.cost) {
+      axis = spatial.axis;
+      SplitReferences(references, spatial, bounds, left, right);
+      auto const kDuplicates = static_cast<int64_t>(left.size()) +
+                               static_cast<int64_t>(right.size()) - kCount;
+      split_budget_.fetch_sub(kDuplicates, std::memory_order_relaxed);
+    }
+    if ((left.empty() || right.empty()) && kObject.bucket > 0) {
+      axis = kObject.axis;
+      auto const kMid = std::partition(
+          references.begin(), references.end(),
+          [&](BvhPrimitive const& primitive) {
+            return BucketIndex(primitive, axis, centroid_bounds) <
+                   kObject.bucket;
+          });
+      left.assign(references.begin(), kMid);
+      right.assign(kMid, references.end());
+    }
+  }
+
+  if (left.empty() || right.empty()) {
+    // no usable SAH split, fall back to the centroid median
+    auto const kMid = references.begin() + kCount / 2;
+    std::nth_element(references.begin(), kMid, references.end(),
+                     [axis](BvhPrimitive const& a, BvhPrimitive const& b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+    left.assign(references.begin(), kMid);
+    right.assign(kMid, references.end());
+  }
+  references = {};
+
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->bounds = bounds;
+  node->axis = static_cast<uint8_t>(axis);
+
+  auto* const kNode = node.get();
+  if (kCount > kTaskThreshold) {
+#pragma omp task firstprivate(kNode, depth) shared(left)
+    kNode->children[0] = BuildSpatial(std::move(left), depth + 1);
+    kNode->children[1] = BuildSpatial(std::move(right), depth + 1);
+#pragma omp taskwait
+  } else {
+    kNode->children[0] = BuildSpatial(std::move(left), depth + 1);
+    kNode->children[1] = BuildSpatial(std::move(right), depth + 1);
+  }
+  return node;
+}
+
+auto BvhBuilder::BuildMorton(int depth) -> std::unique_ptr<BvhBuildNode> {
+  Box bounds;
+  Box centroid_bounds;
+  ComputeBounds(primitives_, bounds, centroid_bounds);
+
+  auto const kCount = static_cast<uint32_t>(primitives_.size());
+  auto const kBitsPerAxis = kCount < kSmallMortonCount ? 10 : 21;
+  auto const kChunks = ChunkCount(kCount);
+  std::vector<MortonPrimitive> morton(kCount);
+#pragma omp taskloop default(shared) grainsize(1)
+  for (uint32_t c = 0; c < kChunks; ++c) {
+    auto const kEnd = std::min(kCount, (c + 1) * kChunkSize);
+    for (auto i = c * kChunkSize; i < kEnd; ++i) {
+      morton[i] = {MortonCode(centroid_bounds.Offset(primitives_[i].centroid),
+                              kBitsPerAxis),
+                   i};
+    }
+  }
+  RadixSort(morton, 3 * kBitsPerAxis);
+
+  std::vector<BvhPrimitive> sorted(kCount);
+  morton_codes_.resize(kCount);
+#pragma omp taskloop default(shared) grainsize(1)
+  for (uint32_t c = 0; c < kChunks; ++c) {
+    auto const kEnd = std::min(kCount, (c + 1) * kChunkSize);
+    for (auto i = c * kChunkSize; i < kEnd; ++i) {
+      sorted[i] = primitives_[morton[i].index];
+      morton_codes_[i] = morton[i].code;
+    }
+  }
+  primitives_ = std::move(sorted);
+
+  auto const kTopBit = 3 * kBitsPerAxis - 1;
+  if (!options_.lbvh_sah_treelets) return EmitLbvh(0, kCount, kTopBit, 0);
+
+  // HLBVH: an LBVH per run of equal leading bits, SAH above the treelets
+  auto const kTreeletShift = 3 * kBitsPerAxis - kTreeletBits;
+  std::vector<uint32_t> starts = {0};
+  for (uint32_t i = 1; i < kCount; ++i)
+    if (morton_codes_[i] >> kTreeletShift !=
+        morton_codes_[i - 1] >> kTreeletShift)
+      starts.push_back(i);
+  starts.push_back(kCount);
+
+  auto const kTreelets = static_cast<uint32_t>(starts.size() - 1);
+  std::vector<std::unique_ptr<BvhBuildNode>> treelets(kTreelets);
+#pragma omp taskloop default(shared) grainsize(1)
+  for (uint32_t t = 0; t < kTreelets; ++t) {
+    auto treelet = std::make_unique<BvhBuildNode>();
+    treelet->bounds = primitives_[starts[t]].bounds;
+    for (auto i = starts[t] + 1; i < starts[t + 1]; ++i)
+      treelet->bounds = treelet->bounds.Union(primitives_[i].bounds);
+    treelet->first_primitive = starts[t];
+    treelet->primitive_count = starts[t + 1] - starts[t];
+    treelets[t] = std::move(treelet);
+  }
+  // the top is built first so that each treelet knows the depth it starts at
+  return BuildTreeletTop(treelets, kTreeletShift - 1, depth);
+}
+
+auto BvhBuilder::EmitLbvh(uint32_t begin, uint32_t end, int bit, int depth)
+    -> std::unique_ptr<BvhBuildNode> {
+  auto const kCount = end - begin;
+  if (kCount <= options_.max_leaf_size) {
+    auto bounds = primitives_[begin].bounds;
+    for (auto i = begin + 1; i < end; ++i)
+      bounds = bounds.Union(primitives_[i].bounds);
+    return MakeLeaf(begin, end, bounds);
+  }
+
+  // all codes in the range agree above bit, so the ones with it set form
+  // the upper part of the range; past kMaxSahDepth only median splits are
+  // made, like BuildRange does
+  auto mid = begin;
+  if (depth >= kMaxSahDepth) bit = -1;
+  for (; bit >= 0; --bit) {
+    auto const kMask = uint64_t{1} << bit;
+    if ((morton_codes_[begin] & kMask) == (morton_codes_[end - 1] & kMask))
+      continue;
+    mid = static_cast<uint32_t>(
+        std::partition_point(morton_codes_.begin() + begin,
+                             morton_codes_.begin() + end,
+                             [kMask](uint64_t code) {
+                               return (code & kMask) == 0;
+                             }) -
+        morton_codes_.begin());
+    break;
+  }
+  // identical codes beyond the leaf size are split in the middle
+  if (bit < 0) mid = begin + kCount / 2;
+
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->axis = static_cast<uint8_t>(bit < 0 ? 0 : 2 - bit % 3);
+
+  auto* const kNode = node.get();
+  if (kCount > kTaskThreshold) {
+#pragma omp task firstprivate(kNode, begin, mid, bit, depth)
+    kNode->children[0] = EmitLbvh(begin, mid, bit - 1, depth + 1);
+    kNode->children[1] = EmitLbvh(mid, end, bit - 1, depth + 1);
+#pragma omp taskwait
+  } else {
+    kNode->children[0] = EmitLbvh(begin, mid, bit - 1, depth + 1);
+    kNode->children[1] = EmitLbvh(mid, end, bit - 1, depth + 1);
+  }
+  node->bounds = node->children[0]->bounds.Union(node->children[1]->bounds);
+  return node;
+}
+
+auto BvhBuilder::BuildTreeletTop(
+    std::span<std::unique_ptr<BvhBuildNode>> treelets, int bit, int depth)
+    -> std::unique_ptr<BvhBuildNode> {
+  if (treelets.size() == 1) {
+    auto const kBegin = treelets[0]->first_primitive;
+    return EmitLbvh(kBegin, kBegin + treelets[0]->primitive_count, bit,
+                    depth);
+  }
+
+  uint32_t count = 0;
+  for (auto const& treelet : treelets) count += treelet->primitive_count;
+  auto const kReference = [](std::unique_ptr<BvhBuildNode> const& treelet) {
+    return BvhPrimitive{treelet->bounds, treelet->bounds.Centroid(), 0};
+  };
+  std::vector<BvhPrimitive> references(treelets.size());
+  std::transform(treelets.begin(), treelets.end(), references.begin(),
+                 kReference);
+  Box bounds;
+  Box centroid_bounds;
+  ComputeBounds(references, bounds, centroid_bounds);
+
+  auto axis = 0;
+  auto mid = treelets.begin();
+  if (depth < kMaxSahDepth) {
+    auto const kSplit = FindObjectSplit(references, centroid_bounds);
+    axis = kSplit.axis;
+    if (kSplit.bucket > 0) {
+      mid = std::partition(
+          treelets.begin(), treelets.end(), [&](auto const& treelet) {
+            return BucketIndex(kReference(treelet), kSplit.axis,
+                               centroid_bounds) < kSplit.bucket;
+          });
+    }
+  }
+  if (mid == treelets.begin() || mid == treelets.end()) {
+    // split the primitives in half, so that the depth stays logarithmic in
+    // their count whatever the treelets below
+    uint32_t left = 0;
+    mid = treelets.begin();
+    while (mid + 1 != treelets.end() &&
+           left + (*mid)->primitive_count <= count / 2)
+      left += (*mid++)->primitive_count;
+    if (mid == treelets.begin()) ++mid;
+  }
+
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->bounds = bounds;
+  node->axis = static_cast<uint8_t>(axis);
+  auto const kLeft = static_cast<size_t>(mid - treelets.begin());
+  auto* const kNode = node.get();
+  if (count > kTaskThreshold) {
+#pragma omp task firstprivate(kNode, treelets, kLeft, bit, depth)
+    kNode->children[0] =
+        BuildTreeletTop(treelets.first(kLeft), bit, depth + 1);
+    kNode->children[1] =
+        BuildTreeletTop(treelets.subspan(kLeft), bit, depth + 1);
+#pragma omp taskwait
+  } else {
+    kNode->children[0] =
+        BuildTreeletTop(treelets.first(kLeft), bit, depth + 1);
+    kNode->children[1] =
+        BuildTreeletTop(treelets.subspan(kLeft), bit, depth + 1);
+  }
+  return node;
+}
+
+auto BvhBuilder::MakeLeaf(uint32_t begin, uint32_t end, Box const& bounds)
+    -> std::unique_ptr<BvhBuildNode> {
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->bounds = bounds;
+  node->first_primitive = begin;
+  node->primitive_count = end - begin;
+  return node;
+}
+
+auto BvhBuilder::MakeLeaf(std::vector<BvhPrimitive> references,
+                          Box const& bounds) -> std::unique_ptr<BvhBuildNode> {
+  auto node = std::make_unique<BvhBuildNode>();
+  node_count_.fetch_add(1, std::memory_order_relaxed);
+  node->bounds = bounds;
+  node->primitive_count = static_cast<uint32_t>(references.size());
+  node->references = std::move(references);
+  return node;
+}
+
+auto BvhBuilder::LeafIsCheaper(uint32_t count, double split_cost,
+                               Box const& bounds) const -> bool {
+  auto const kSplitCost =
+      options_.traversal_cost +
+      options_.intersection_cost * split_cost / bounds.SurfaceArea();
+  auto const kBatchSize = std::max(options_.leaf_batch_size, 1U);
+  auto const kLeafCost =
+      options_.intersection_cost * ((count + kBatchSize - 1) / kBatchSize);
+  return !(kSplitCost < kLeafCost);
+}
+
+auto BvhBuilder::FindObjectSplit(References references,
+                                 Box const& centroid_bounds) const
+    -> ObjectSplit {
+  Bins bins;
+  ComputeBins(references, centroid_bounds, bins);
+
+  ObjectSplit split{std::numeric_limits<double>::infinity(),
+                    centroid_bounds.MaxExtent(), 0, {}, {}};
+  for (int i = 0; i < 3; ++i) {
+    if (centroid_bounds.max[i] <= centroid_bounds.min[i]) continue;
+
+    // sweep from the right to get the cost of every right-hand side
+    std::array<Bucket, kBucketCount> right{};
+    for (int j = kBucketCount - 1; j > 0; --j) {
+      right[j] = bins[i][j];
+      if (j < kBucketCount - 1) right[j].Merge(right[j + 1]);
+    }
+    Bucket left;
+    for (int j = 1; j < kBucketCount; ++j) {
+      left.Merge(bins[i][j - 1]);
+      if (left.count == 0 || right[j].count == 0) continue;
+      if (auto const kCost = left.count * left.bounds.SurfaceArea() +
+                             right[j].count * right[j].bounds.SurfaceArea();
+          kCost < split.cost) {
+        split = {kCost, i, j, left, right[j]};
+      }
+    }
+  }
+  return split;
+}
+
+auto BvhBuilder::FindSpatialSplit(References references,
+                                  Box const& bounds) const -> SpatialSplit {
+  SpatialSplit split{std::numeric_limits<double>::infinity(), 0, 0, {}, {}};
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const kExtent = bounds.max[axis] - bounds.min[axis];
+    if (!(kExtent > 0) || !std::isfinite(kExtent)) continue;
+    auto const kBinWidth = kExtent / kSpatialBinCount;
+    auto const kBin = [&](double x) {
+      auto const kIndex =
+          static_cast<int>((x - bounds.min[axis]) / kBinWidth);
+      return std::clamp(kIndex, 0, kSpatialBinCount - 1);
+    };
+
+    // every reference is clipped into each bin it overlaps, and counted
+    // where it enters and where it leaves
+    std::array<Bucket, kSpatialBinCount> bins{};
+    std::array<uint32_t, kSpatialBinCount> entries{};
+    std::array<uint32_t, kSpatialBinCount> exits{};
+    for (auto const& reference : references) {
+      auto const kFirst = kBin(reference.bounds.min[axis]);
+      auto const kLast = std::max(kFirst, kBin(reference.bounds.max[axis]));
+      if (kFirst == kLast) {
+        bins[kFirst].Add(reference.bounds);
+      } else {
+        auto slab = bounds;
+        for (int b = kFirst; b <= kLast; ++b) {
+          slab.min[axis] = bounds.min[axis] + kBinWidth * b;
+          slab.max[axis] = b == kSpatialBinCount - 1
+                               ? bounds.max[axis]
+                               : bounds.min[axis] + kBinWidth * (b + 1);
+          if (auto const kPiece = ClipReference(reference, slab);
+              !kPiece.bounds.Empty())
+            bins[b].Add(kPiece.bounds);
+        }
+      }
+      ++entries[kFirst];
+      ++exits[kLast];
+    }
+
+    std::array<Bucket, kSpatialBinCount> right{};
+    std::array<uint32_t, kSpatialBinCount> right_count{};
+    for (int j = kSpatialBinCount - 1; j > 0; --j) {
+      right[j] = bins[j];
+      right_count[j] = exits[j];
+      if (j < kSpatialBinCount - 1) {
+        right[j].Merge(right[j + 1]);
+        right_count[j] += right_count[j + 1];
+      }
+    }
+    Bucket left;
+    uint32_t left_count = 0;
+    for (int j = 1; j < kSpatialBinCount; ++j) {
+      left.Merge(bins[j - 1]);
+      left_count += entries[j - 1];
+      if (left_count == 0 || right_count[j] == 0 || left.count == 0 ||
+          right[j].count == 0)
+        continue;
+      if (auto const kCost = left_count * left.bounds.SurfaceArea() +
+                             right_count[j] * right[j].bounds.SurfaceArea();
+          kCost < split.cost) {
+        split = {kCost,
+                 axis,
+                 bounds.min[axis] + kBinWidth * j,
+                 {left.bounds, left_count},
+                 {right[j].bounds, right_count[j]}};
+      }
+    }
+  }
+  return split;
+}
+
+void BvhBuilder::SplitReferences(References references,
+                                 SpatialSplit const& split, Box const& bounds,
+                                 std::vector<BvhPrimitive>& left,
+                                 std::vector<BvhPrimitive>& right) const {
+  auto const kAxis = split.axis;
+  auto left_slab = bounds;
+  auto right_slab = bounds;
+  left_slab.max[kAxis] = split.position;
+  right_slab.min[kAxis] = split.position;
+
+  // costs of the binned split, used to decide per straddling reference
+  // whether keeping it whole on one side is cheaper (reference unsplitting)
+  auto const kLeftArea = split.left.bounds.SurfaceArea();
+  auto const kRightArea = split.right.bounds.SurfaceArea();
+  auto const kLeftCount = static_cast<double>(split.left.count);
+  auto const kRightCount = static_cast<double>(split.right.count);
+  auto const kSplitCost = kLeftArea * kLeftCount + kRightArea * kRightCount;
+
+  for (auto const& reference : references) {
+    if (reference.bounds.max[kAxis] <= split.position) {
+      left.push_back(reference);
+      continue;
+    }
+    if (reference.bounds.min[kAxis] >= split.position) {
+      right.push_back(reference);
+      continue;
+    }
+
+    auto const kLeftPiece = ClipReference(reference, left_slab);
+    auto const kRightPiece = ClipReference(reference, right_slab);
+    if (kRightPiece.bounds.Empty()) {
+      left.push_back(kLeftPiece);
+      continue;
+    }
+    if (kLeftPiece.bounds.Empty()) {
+      right.push_back(kRightPiece);
+      continue;
+    }
+
+    auto const kLeftCost =
+        split.left.bounds.Union(reference.bounds).SurfaceArea() * kLeftCount +
+        kRightArea * (kRightCount - 1);
+    auto const kRightCost =
+        kLeftArea * (kLeftCount - 1) +
+        split.right.bounds.Union(reference.bounds).SurfaceArea() * kRightCount;
+    if (kLeftCost < kSplitCost && kLeftCost <= kRightCost) {
+      left.push_back(reference);
+    } else if (kRightCost < kSplitCost) {
+      right.push_back(reference);
+    } else {
+      left.push_back(kLeftPiece);
+      right.push_back(kRightPiece);
+    }
+  }
+}
+
+auto BvhBuilder::ClipReference(BvhPrimitive const& reference,
+                               Box const& clip) const -> BvhPrimitive {
+  auto clipped = reference;
+  clipped.bounds = clip_ ? clip_(reference.index, clip).Clip(reference.bounds)
+                         : reference.bounds.Clip(clip);
+  clipped.centroid = clipped.bounds.Centroid();
+  return clipped;
+}
+
+void BvhBuilder::Gather(BvhBuildNode& node) {
+  if (node.children[0] == nullptr) {
+    node.first_primitive = static_cast<uint32_t>(primitives_.size());
+    primitives_.insert(primitives_.end(), node.references.begin(),
+                       node.references.end());
+    node.references = {};
+    return;
+  }
+  Gather(*node.children[0]);
+  Gather(*node.children[1]);
+}
+
+void BvhBuilder::ComputeBounds(References references, Box& bounds,
+                               Box& centroid_bounds) {
+  auto const kReduce = [references](size_t first, size_t last, Box& b,
+                                    Box& c) {
+    b = references[first].bounds;
+    c = Box(references[first].centroid);
+    for (auto i = first + 1; i < last; ++i) {
+      b = b.Union(references[i].bounds);
+      c = c.Union(Box(references[i].centroid));
+    }
+  };
+
+  if (references.size() < kParallelBinThreshold) {
+    kReduce(0, references.size(), bounds, centroid_bounds);
+    return;
+  }
+
+  auto const kChunks = ChunkCount(references.size());
+  std::vector<Box> chunk_bounds(kChunks);
+  std::vector<Box> chunk_centroids(kChunks);
+#pragma omp taskloop default(shared) grainsize(1)
+  for (uint32_t c = 0; c < kChunks; ++c) {
+    size_t const kFirst = static_cast<size_t>(c) * kChunkSize;
+    kReduce(kFirst, std::min(references.size(), kFirst + kChunkSize),
+            chunk_bounds[c], chunk_centroids[c]);
+  }
+
+  bounds = chunk_bounds[0];
+  centroid_bounds = chunk_centroids[0];
+  for (uint32_t c = 1; c < kChunks; ++c) {
+    bounds = bounds.Union(chunk_bounds[c]);
+    centroid_bounds = centroid_bounds.Union(chunk_centroids[c]);
+  }
+}
+
+void BvhBuilder::ComputeBins(References references, Box const& centroid_bounds,
+                             Bins& bins) {
+  auto const kBin = [&](size_t first, size_t last, Bins& b) {
+    for (auto i = first; i < last; ++i)
+      for (int axis = 0; axis < 3; ++axis)
+        b[axis][BucketIndex(references[i], axis, centroid_bounds)].Add(
+            references[i].bounds);
+  };
+
+  bins = Bins{};
+  if (references.size() < kParallelBinThreshold) {
+    kBin(0, references.size(), bins);
+    return;
+  }
+
+  auto const kChunks = ChunkCount(references.size());
+  std::vector<Bins> chunk_bins(kChunks);
+#pragma omp taskloop default(shared) grainsize(1)
+  for (uint32_t c = 0; c < kChunks; ++c) {
+    size_t const kFirst = static_cast<size_t>(c) * kChunkSize;
+    kBin(kFirst, std::min(references.size(), kFirst + kChunkSize),
+         chunk_bins[c]);
+  }
+
+  for (auto const& chunk : chunk_bins)
+    for (int axis = 0; axis < 3; ++axis)
+      for (int j = 0; j < kBucketCount; ++j)
+        bins[axis][j].Merge(chunk[axis][j]);
+}
+
+auto BvhBuilder::BucketIndex(BvhPrimitive const& primitive, int axis,
+                             Box const& centroid_bounds) -> int {
+  auto const kBucket = static_cast<int>(
+      kBucketCount * centroid_bounds.Offset(primitive.centroid)[axis]);
+  return std::clamp(kBucket, 0, kBucketCount - 1);
+}
+}  // namespace cherry
@@ -0,0 +1,222 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : bvh_cache.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 21:12
+// Description : Versioned on-disk cache of the flattened BVH
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <system_error>
+#include <tuple>
+#include <typeinfo>
+
+#include "acceleration/bvh.h"
+#include "fmt/core.h"
+
+namespace cherry {
+namespace {
+constexpr std::array<char, 8> kCacheMagic = {'C', 'H', 'R', 'Y',
+                                             'B', 'V', 'H', '\0'};
+// bump whenever the file layout or the meaning of a field changes, or when
+// trees built before are no longer valid (3: depth-limited LBVH builds)
+constexpr uint32_t kCacheVersion = 3;
+constexpr int64_t kHashChunkSize = 1 << 16;
+
+/**
+ * @brief Start of a cache file. The header is padded to kCacheHeaderSize and
+ * followed by the binary nodes, the wide nodes of the layout and the index of
+ * the object behind every primitive reference. Files are native-endian.
+ */
+struct CacheHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  // rejects files written by a build with a different node layout
+  uint32_t node_size;
+  uint64_t key;
+  uint64_t node_count;
+  uint64_t wide_node_count;
+  uint64_t primitive_count;
+  uint8_t layout;
+};
+// keeps the node arrays behind the header aligned to their 64 bytes
+constexpr size_t kCacheHeaderSize = 64;
+static_assert(sizeof(CacheHeader) <= kCacheHeaderSize);
+
+// order dependent, so that permuting the objects changes the key
+auto Mix(uint64_t hash, uint64_t value) -> uint64_t {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return (hash ^ value) * 0x100000001b3ULL;
+}
+
+auto Mix(uint64_t hash, double value) -> uint64_t {
+  return Mix(hash, std::bit_cast<uint64_t>(value));
+}
+
+auto Mix(uint64_t hash, math::Point3 const& point) -> uint64_t {
+  return Mix(Mix(Mix(hash, point.x), point.y), point.z);
+}
+
+template <typename T>
+auto AsBytes(std::vector<T> const& values) -> std::span<char const> {
+  return {reinterpret_cast<char const*>(values.data()),
+          values.size() * sizeof(T)};
+}
+
+template <typename T>
+auto MappedArray(std::byte const* data, size_t count) -> std::span<T const> {
+  return {reinterpret_cast<T const*>(data), count};
+}
+}  // namespace
+
+auto Bvh::CacheKey(std::vector<std::shared_ptr<Object>> const& objects,
+                   BvhBuildOptions const& options) -> uint64_t {
+  // everything the hierarchy depends on: the options shaping the tree, the
+  // type and bounds of every object, and the points spatial splits clip it by
+  auto hash = Mix(uint64_t{kCacheVersion}, uint64_t{objects.size()});
+  hash = Mix(hash, uint64_t{options.max_leaf_size});
+  hash = Mix(hash, options.traversal_cost);
+  hash = Mix(hash, options.intersection_cost);
+  hash = Mix(hash, uint64_t{options.leaf_batch_size});
+  hash = Mix(hash, static_cast<uint64_t>(options.layout));
+  hash = Mix(hash, static_cast<uint64_t>(options.quality));
+  hash = Mix(hash, options.split_budget);
+  hash = Mix(hash, uint64_t{options.lbvh_sah_treelets});
+  hash = Mix(hash, static_cast<uint64_t>(options.node_order));
+  hash = Mix(hash, uint64_t{options.treelet_profile_rays});
+
+  auto const kCount = static_cast<int64_t>(objects.size());
+  auto const kChunkCount = (kCount + kHashChunkSize - 1) / kHashChunkSize;
+  std::vector<uint64_t> chunk_hashes(kChunkCount);
+#pragma omp parallel for
+  for (int64_t c = 0; c < kChunkCount; ++c) {
+    uint64_t chunk_hash = 0;
+    std::vector<math::Point3> clip_points;
+    auto const kEnd = std::min(kCount, (c + 1) * kHashChunkSize);
+    for (auto i = c * kHashChunkSize; i < kEnd; ++i) {
+      auto& object = *objects[i];
+      auto const kBounds = object.GetBounds();
+      chunk_hash = Mix(chunk_hash, uint64_t{typeid(object).hash_code()});
+      chunk_hash = Mix(Mix(chunk_hash, kBounds.min), kBounds.max);
+      clip_points.clear();
+      object.AppendClipPoints(clip_points);
+      for (auto const& point : clip_points)
+        chunk_hash = Mix(chunk_hash, point);
+    }
+    chunk_hashes[c] = chunk_hash;
+  }
+  for (auto const kChunkHash : chunk_hashes) hash = Mix(hash, kChunkHash);
+  return hash;
+}
+
+auto Bvh::LoadCache(std::vector<std::shared_ptr<Object>> const& objects,
+                    uint64_t key, std::vector<uint32_t>& slots) -> bool {
+  auto mapping = std::make_shared<MappedFile const>(options_.cache_file);
+  auto const kBytes = mapping->Bytes();
+  if (kBytes.size() < kCacheHeaderSize) return false;
+
+  CacheHeader header{};
+  std::memcpy(&header, kBytes.data(), sizeof(header));
+  if (header.magic != kCacheMagic || header.version != kCacheVersion ||
+      header.node_size != sizeof(LinearBvhNode) || header.key != key ||
+      header.layout != static_cast<uint8_t>(options_.layout) ||
+      header.node_count == 0)
+    return false;
+  size_t wide_node_size = 0;
+  VisitWideNodes(*this, [&](auto& array) {
+    wide_node_size = sizeof(typename decltype(array.nodes)::value_type);
+  });
+  auto const kWideBytes = header.wide_node_count * wide_node_size;
+  auto const kNodeBytes = header.node_count * sizeof(LinearBvhNode);
+  if (kBytes.size() != kCacheHeaderSize + kNodeBytes + kWideBytes +
+                           header.primitive_count * sizeof(uint32_t))
+    return false;
+
+  auto const* const kNodeData = kBytes.data() + kCacheHeaderSize;
+  auto const* const kWideData = kNodeData + kNodeBytes;
+  auto const kIndices =
+      MappedArray<uint32_t>(kWideData + kWideBytes, header.primitive_count);
+  for (auto const kIndex : kIndices)
+    if (kIndex >= objects.size()) return false;
+  slots.assign(kIndices.begin(), kIndices.end());
+
+  mapped_nodes_ = MappedArray<LinearBvhNode>(kNodeData, header.node_count);
+  VisitWideNodes(*this, [&](auto& array) {
+    using Node = typename decltype(array.nodes)::value_type;
+    array.mapped = MappedArray<Node>(kWideData, header.wide_node_count);
+  });
+  mapping_ = std::move(mapping);
+  return true;
+}
+
+void Bvh::SaveCache(std::span<BvhPrimitive const> references,
+                    uint64_t key) const {
+  CacheHeader header{};
+  header.magic = kCacheMagic;
+  header.version = kCacheVersion;
+  header.node_size = sizeof(LinearBvhNode);
+  header.key = key;
+  header.layout = static_cast<uint8_t>(options_.layout);
+  header.node_count = nodes_.size();
+  std::span<char const> wide_bytes;
+  VisitWideNodes(*this, [&](auto const& array) {
+    header.wide_node_count = array.nodes.size();
+    wide_bytes = AsBytes(array.nodes);
+  });
+  header.primitive_count = references.size();
+  std::array<char, kCacheHeaderSize> header_bytes{};
+  std::memcpy(header_bytes.data(), &header, sizeof(header));
+
+  std::vector<uint32_t> indices;
+  indices.reserve(references.size());
+  for (auto const& reference : references) indices.push_back(reference.index);
+
+  // written beside the target and renamed over it, so a concurrent render
+  // never maps a half written file and processes that mapped the old one
+  // keep reading it
+  auto temp = options_.cache_file;
+  temp += fmt::format(".{:08x}.tmp", std::random_device{}());
+  std::error_code error;
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(header_bytes.data(), header_bytes.size());
+    for (auto const kBytes : {AsBytes(nodes_), wide_bytes, AsBytes(indices)})
+      out.write(kBytes.data(), static_cast<std::streamsize>(kBytes.size()));
+    if (!out) error = std::make_error_code(std::errc::io_error);
+  }
+  if (!error) std::filesystem::rename(temp, options_.cache_file, error);
+  if (error) {
+    fmt::print(stderr, "Unable to write BVH cache {}: {}\n",
+               options_.cache_file.string(), error.message());
+    std::filesystem::remove(temp, error);
+  }
+}
+
+void Bvh::Detach() {
+  if (!mapping_) return;
+  nodes_.assign(mapped_nodes_.begin(), mapped_nodes_.end());
+  mapped_nodes_ = {};
+  std::apply(
+      [](auto&... arrays) {
+        ((arrays.nodes.assign(arrays.mapped.begin(), arrays.mapped.end()),
+          arrays.mapped = {}),
+         ...);
+      },
+      wide_nodes_);
+  mapping_.reset();
+  // the refit baseline is the cost of the hierarchy as it was cached
+  ComputeCosts(build_costs_);
+}
+}  // namespace cherry
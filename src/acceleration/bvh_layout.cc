@@ -0,0 +1,126 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : bvh_layout.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 0:32
+// Description : Memory order of the binary BVH nodes
+
+#include <array>
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <utility>
+
+#include "acceleration/bvh.h"
+
+namespace cherry {
+namespace {
+// nodes of a treelet, the ones filling a 4 KiB page
+constexpr size_t kTreeletNodes = 4096 / sizeof(LinearBvhNode);
+}  // namespace
+
+/**
+ * Treelets are formed greedily: starting from its root, a treelet takes the
+ * heaviest node on its frontier until it fills a page, and the frontier that
+ * is left over roots the next treelets. Treelets are laid out in the order
+ * their roots were found, so children still come after their parent.
+ */
+void Bvh::LayOutTreelets(std::vector<double> const& weights) {
+  std::vector<uint32_t> order;
+  order.reserve(nodes_.size());
+  std::deque<uint32_t> roots = {0};
+  std::priority_queue<std::pair<double, uint32_t>> frontier;
+  while (!roots.empty()) {
+    frontier.emplace(weights[roots.front()], roots.front());
+    roots.pop_front();
+    for (size_t size = 0; size < kTreeletNodes && !frontier.empty(); ++size) {
+      auto const kIndex = frontier.top().second;
+      frontier.pop();
+      order.push_back(kIndex);
+      auto const& node = nodes_[kIndex];
+      if (node.primitive_count > 0) continue;
+      for (auto const kChild :
+           {node.first_child_offset, node.second_child_offset})
+        frontier.emplace(weights[kChild], kChild);
+    }
+    for (; !frontier.empty(); frontier.pop())
+      roots.push_back(frontier.top().second);
+  }
+  PermuteNodes(order);
+}
+
+void Bvh::RestoreDepthFirst() {
+  std::vector<uint32_t> order;
+  order.reserve(nodes_.size());
+  std::vector<uint32_t> stack = {0};
+  while (!stack.empty()) {
+    auto const kIndex = stack.back();
+    stack.pop_back();
+    order.push_back(kIndex);
+    auto const& node = nodes_[kIndex];
+    if (node.primitive_count > 0) continue;
+    stack.push_back(node.second_child_offset);
+    stack.push_back(node.first_child_offset);
+  }
+  PermuteNodes(order);
+}
+
+void Bvh::PermuteNodes(std::vector<uint32_t> const& order) {
+  std::vector<uint32_t> position(nodes_.size());
+  for (uint32_t i = 0; i < order.size(); ++i) position[order[i]] = i;
+
+  std::vector<LinearBvhNode> nodes(nodes_.size());
+  std::vector<double> costs(build_costs_.size());
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    auto& node = nodes[i];
+    node = nodes_[order[i]];
+    if (node.primitive_count == 0) {
+      node.first_child_offset = position[node.first_child_offset];
+      node.second_child_offset = position[node.second_child_offset];
+    }
+    if (!costs.empty()) costs[i] = build_costs_[order[i]];
+  }
+  nodes_.swap(nodes);
+  build_costs_.swap(costs);
+}
+
+auto Bvh::AreaWeights() const -> std::vector<double> {
+  // the SAH assumption: a ray entering the root enters a node with the
+  // probability of its surface area relative to the root
+  std::vector<double> weights(nodes_.size());
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    auto const kArea = nodes_[i].bounds.SurfaceArea();
+    weights[i] = std::isfinite(kArea) ? kArea : 0.0;
+  }
+  return weights;
+}
+
+auto Bvh::CountVisits(std::span<Ray const> rays) const -> std::vector<double> {
+  std::vector<double> visits(nodes_.size());
+#pragma omp parallel
+  {
+    std::vector<double> local(nodes_.size());
+#pragma omp for schedule(dynamic, 64)
+    for (int64_t r = 0; r < static_cast<int64_t>(rays.size()); ++r) {
+      // the closest-hit traversal of IntersectBinary, counting every node
+      // whose box is tested
+      auto ray = rays[r];
+      TraverseBinary(
+          std::span<LinearBvhNode const>(nodes_), 0, ray, true,
+          [&](LinearBvhNode const& node) {
+            HitRecord record;
+            IntersectLeaf(node.primitives_offset, node.primitive_count, ray,
+                          record);
+            return false;
+          },
+          [&](uint32_t index) { ++local[index]; });
+    }
+#pragma omp critical
+    for (size_t i = 0; i < visits.size(); ++i) visits[i] += local[i];
+  }
+  return visits;
+}
+}  // namespace cherry
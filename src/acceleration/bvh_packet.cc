@@ -0,0 +1,298 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : bvh_packet.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 23:05
+// Description : Ray packet traversal of the binary BVH
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#include "acceleration/bvh.h"
+
+namespace cherry {
+namespace {
+// below this many active rays a subtree is cheaper to finish ray by ray
+constexpr int kMinPacketRays = 3;
+// widens the exit distance like Box::IntersectP does
+constexpr double kHalfEpsilon = std::numeric_limits<double>::epsilon() * 0.5;
+constexpr double kSlabRobustness =
+    1 + 2 * (3 * kHalfEpsilon) / (1 - 3 * kHalfEpsilon);
+
+template <typename T>
+using Lanes = std::array<T, kPacketSize>;
+
+// the rays of a packet as SoA lanes, unused lanes never enter a box
+struct PacketRays {
+  std::array<Lanes<double>, 3> origin;
+  std::array<Lanes<double>, 3> inv_dir;
+  Lanes<double> t_min;
+  Lanes<double> t_max;
+};
+
+/**
+ * @brief Bounds of the rays of a coherent packet. Floating point operations
+ * are monotonic, so the slab distances computed from these bounds enclose the
+ * distances every ray computes on its own.
+ */
+struct PacketInterval {
+  std::array<double, 3> origin_min;
+  std::array<double, 3> origin_max;
+  std::array<double, 3> inv_dir_min;
+  std::array<double, 3> inv_dir_max;
+  std::array<bool, 3> negative;
+  double t_min;
+  double t_max;
+};
+
+auto MakePacketRays(RayPacket const& packet) -> PacketRays {
+  PacketRays rays{};
+  for (int i = 0; i < kPacketSize; ++i) {
+    if ((packet.mask >> i & 1U) == 0) {
+      rays.t_min[i] = 1;
+      rays.t_max[i] = 0;
+      continue;
+    }
+    auto const& ray = packet.rays[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      rays.origin[axis][i] = ray.origin[axis];
+      rays.inv_dir[axis][i] = ray.direction_inv[axis];
+    }
+    rays.t_min[i] = ray.t_min;
+    rays.t_max[i] = ray.t_max;
+  }
+  return rays;
+}
+
+auto MaxTMax(PacketRays const& rays, uint32_t mask) -> double {
+  auto t_max = -std::numeric_limits<double>::infinity();
+  for (; mask != 0; mask &= mask - 1)
+    t_max = std::max(t_max, rays.t_max[std::countr_zero(mask)]);
+  return t_max;
+}
+
+/**
+ * @brief Bound the rays of the lanes in mask
+ *
+ * @return false if the rays do not share their direction signs or an inverse
+ * direction is not finite, the packet is not coherent enough to share nodes
+ */
+auto MakePacketInterval(PacketRays const& rays, uint32_t mask,
+                        PacketInterval& interval) -> bool {
+  auto const kFirst = std::countr_zero(mask);
+  for (int axis = 0; axis < 3; ++axis) {
+    interval.origin_min[axis] = interval.origin_max[axis] =
+        rays.origin[axis][kFirst];
+    interval.inv_dir_min[axis] = interval.inv_dir_max[axis] =
+        rays.inv_dir[axis][kFirst];
+    interval.negative[axis] = rays.inv_dir[axis][kFirst] < 0;
+  }
+  interval.t_min = rays.t_min[kFirst];
+  for (auto lanes = mask; lanes != 0; lanes &= lanes - 1) {
+    auto const kLane = std::countr_zero(lanes);
+    for (int axis = 0; axis < 3; ++axis) {
+      auto const kInvDir = rays.inv_dir[axis][kLane];
+      if (!std::isfinite(kInvDir) ||
+          (kInvDir < 0) != interval.negative[axis])
+        return false;
+      interval.origin_min[axis] =
+          std::min(interval.origin_min[axis], rays.origin[axis][kLane]);
+      interval.origin_max[axis] =
+          std::max(interval.origin_max[axis], rays.origin[axis][kLane]);
+      interval.inv_dir_min[axis] =
+          std::min(interval.inv_dir_min[axis], kInvDir);
+      interval.inv_dir_max[axis] =
+          std::max(interval.inv_dir_max[axis], kInvDir);
+    }
+    interval.t_min = std::min(interval.t_min, rays.t_min[kLane]);
+  }
+  interval.t_max = MaxTMax(rays, mask);
+  return true;
+}
+
+// true if no ray of the packet can enter the box
+auto IntervalMiss(Box const& box, PacketInterval const& interval) -> bool {
+  auto t0 = interval.t_min;
+  auto t1 = interval.t_max;
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const kIMin = interval.inv_dir_min[axis];
+    auto const kIMax = interval.inv_dir_max[axis];
+    // extremes of box.min - origin and box.max - origin over the packet
+    auto const kMinLo = box.min[axis] - interval.origin_max[axis];
+    auto const kMaxHi = box.max[axis] - interval.origin_min[axis];
+    double t_near = 0;
+    double t_far = 0;
+    if (interval.negative[axis]) {
+      t_near = kMaxHi >= 0 ? kMaxHi * kIMin : kMaxHi * kIMax;
+      t_far = kMinLo >= 0 ? kMinLo * kIMax : kMinLo * kIMin;
+    } else {
+      t_near = kMinLo >= 0 ? kMinLo * kIMin : kMinLo * kIMax;
+      t_far = kMaxHi >= 0 ? kMaxHi * kIMax : kMaxHi * kIMin;
+    }
+    t0 = std::max(t0, t_near);
+    t1 = std::min(t1, t_far * kSlabRobustness);
+  }
+  return t0 > t1;
+}
+
+// lanes of mask whose ray enters the box, a Box::IntersectP per lane
+auto SlabTest(Box const& box, PacketRays const& rays, uint32_t mask)
+    -> uint32_t {
+  uint32_t hit = 0;
+#pragma omp simd reduction(| : hit)
+  for (int i = 0; i < kPacketSize; ++i) {
+    auto t0 = rays.t_min[i];
+    auto t1 = rays.t_max[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      auto const kA = (box.min[axis] - rays.origin[axis][i]) *
+                      rays.inv_dir[axis][i];
+      auto const kB = (box.max[axis] - rays.origin[axis][i]) *
+                      rays.inv_dir[axis][i];
+      auto const kNear = std::min(kA, kB);
+      auto const kFar = std::max(kA, kB) * kSlabRobustness;
+      // written so that a NaN from 0 * inf leaves the interval untouched
+      t0 = kNear > t0 ? kNear : t0;
+      t1 = kFar < t1 ? kFar : t1;
+    }
+    hit |= static_cast<uint32_t>(t0 <= t1) << i;
+  }
+  return hit & mask;
+}
+
+struct PacketStackEntry {
+  uint32_t node;
+  uint32_t mask;
+};
+}  // namespace
+
+auto Bvh::Intersect(RayPacket const& packet,
+                    std::span<Intersection, kPacketSize> intersections) const
+    -> uint32_t {
+  auto const kNodes = Nodes();
+  if (kNodes.empty() || packet.mask == 0) return 0;
+
+  auto rays = MakePacketRays(packet);
+  PacketInterval interval{};
+  uint32_t hit = 0;
+  // wide nodes already test their children together for a single ray
+  if (options_.layout != BvhLayout::kBinary ||
+      !MakePacketInterval(rays, packet.mask, interval)) {
+    for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+      auto const kLane = std::countr_zero(lanes);
+      if (Intersect(packet.rays[kLane], intersections[kLane]))
+        hit |= 1U << kLane;
+    }
+    return hit;
+  }
+
+  // attributes are computed at the end, for the closest hit of each lane
+  std::array<HitRecord, kPacketSize> records{};
+  std::array<PacketStackEntry, kMaxBvhDepth> stack{};
+  int stack_size = 0;
+  PacketStackEntry current = {0, packet.mask};
+  while (true) {
+    auto const& node = kNodes[current.node];
+    auto mask = IntervalMiss(node.bounds, interval)
+                    ? 0U
+                    : SlabTest(node.bounds, rays, current.mask);
+    if (mask != 0 && std::popcount(mask) < kMinPacketRays) {
+      // the packet has diverged, finish the subtree ray by ray
+      for (auto lanes = mask; lanes != 0; lanes &= lanes - 1) {
+        auto const kLane = std::countr_zero(lanes);
+        auto ray = packet.rays[kLane];
+        ray.t_max = rays.t_max[kLane];
+        if (IntersectBinary(ray, records[kLane], current.node)) {
+          rays.t_max[kLane] = records[kLane].distance;
+          hit |= 1U << kLane;
+        }
+      }
+      interval.t_max = MaxTMax(rays, packet.mask);
+    } else if (mask != 0 && node.primitive_count > 0) {
+      for (auto lanes = mask; lanes != 0; lanes &= lanes - 1) {
+        auto const kLane = std::countr_zero(lanes);
+        auto ray = packet.rays[kLane];
+        ray.t_max = rays.t_max[kLane];
+        if (IntersectLeaf(node.primitives_offset, node.primitive_count, ray,
+                          records[kLane]))
+          hit |= 1U << kLane;
+        rays.t_max[kLane] = ray.t_max;
+      }
+      interval.t_max = MaxTMax(rays, packet.mask);
+    } else if (mask != 0) {
+      // visit the child nearer to the packet first
+      auto const kFirst = node.first_child_offset;
+      auto const kSecond = node.second_child_offset;
+      auto const kNegative = interval.negative[node.axis];
+      stack[stack_size++] = {kNegative ? kFirst : kSecond, mask};
+      current = {kNegative ? kSecond : kFirst, mask};
+      continue;
+    }
+    if (stack_size == 0) break;
+    current = stack[--stack_size];
+  }
+  for (auto lanes = hit; lanes != 0; lanes &= lanes - 1) {
+    auto const kLane = std::countr_zero(lanes);
+    FillIntersection(packet.rays[kLane], records[kLane], intersections[kLane]);
+  }
+  return hit;
+}
+
+auto Bvh::IntersectAny(RayPacket const& packet) const -> uint32_t {
+  auto const kNodes = Nodes();
+  if (kNodes.empty() || packet.mask == 0) return 0;
+
+  auto const kRays = MakePacketRays(packet);
+  PacketInterval interval{};
+  uint32_t hit = 0;
+  if (options_.layout != BvhLayout::kBinary ||
+      !MakePacketInterval(kRays, packet.mask, interval)) {
+    for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+      auto const kLane = std::countr_zero(lanes);
+      if (IntersectAny(packet.rays[kLane])) hit |= 1U << kLane;
+    }
+    return hit;
+  }
+
+  std::array<PacketStackEntry, kMaxBvhDepth> stack{};
+  int stack_size = 0;
+  PacketStackEntry current = {0, packet.mask};
+  while (true) {
+    auto const& node = kNodes[current.node];
+    // lanes that already hit something are done
+    auto mask = current.mask & ~hit;
+    if (mask != 0)
+      mask = IntervalMiss(node.bounds, interval)
+                 ? 0U
+                 : SlabTest(node.bounds, kRays, mask);
+    if (mask != 0 && std::popcount(mask) < kMinPacketRays) {
+      for (auto lanes = mask; lanes != 0; lanes &= lanes - 1) {
+        auto const kLane = std::countr_zero(lanes);
+        if (IntersectAnyBinary(packet.rays[kLane], current.node))
+          hit |= 1U << kLane;
+      }
+      if (hit == packet.mask) break;
+    } else if (mask != 0 && node.primitive_count > 0) {
+      for (auto lanes = mask; lanes != 0; lanes &= lanes - 1) {
+        auto const kLane = std::countr_zero(lanes);
+        if (IntersectLeafAny(node.primitives_offset, node.primitive_count,
+                             packet.rays[kLane]))
+          hit |= 1U << kLane;
+      }
+      if (hit == packet.mask) break;
+    } else if (mask != 0) {
+      stack[stack_size++] = {node.second_child_offset, mask};
+      current = {node.first_child_offset, mask};
+      continue;
+    }
+    if (stack_size == 0) break;
+    current = stack[--stack_size];
+  }
+  return hit;
+}
+}  // namespace cherry
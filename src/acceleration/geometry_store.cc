@@ -0,0 +1,152 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : geometry_store.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 6:10
+// Description : Primitives of a BVH in one contiguous array per type
+
+#include "acceleration/geometry_store.h"
+
+#include <typeinfo>
+
+#include "object/mesh.h"
+
+namespace cherry {
+auto KindOf(Object const& object) -> PrimitiveKind {
+  auto const& type = typeid(object);
+  if (type == typeid(Sphere)) return PrimitiveKind::kSphere;
+  if (type == typeid(Cuboid)) return PrimitiveKind::kCuboid;
+  if (type == typeid(Plane)) return PrimitiveKind::kPlane;
+  if (type == typeid(Triangle)) return PrimitiveKind::kTriangle;
+  if (type == typeid(Mesh)) return PrimitiveKind::kMesh;
+  return PrimitiveKind::kOther;
+}
+
+void GeometryStore::Build(std::span<std::shared_ptr<Object> const> objects,
+                          std::span<uint32_t const> slots) {
+  refs_.assign(objects.size(), {PrimitiveKind::kOther, UINT32_MAX});
+  spheres_.clear();
+  cuboids_.clear();
+  planes_.clear();
+  triangles_.clear();
+  meshes_.clear();
+  others_.clear();
+  // append object to the array of its kind and return its entry there
+  auto const kAppend = [](auto& array, auto&& object) {
+    array.push_back(object);
+    return static_cast<uint32_t>(array.size() - 1);
+  };
+  for (auto const kObject : slots) {
+    auto& ref = refs_[kObject];
+    if (ref.index != UINT32_MAX) continue;
+    auto const& owner = objects[kObject];
+    auto const& object = *owner;
+    ref.kind = KindOf(object);
+    switch (ref.kind) {
+      case PrimitiveKind::kSphere:
+        ref.index = kAppend(spheres_, static_cast<Sphere const&>(object));
+        break;
+      case PrimitiveKind::kCuboid:
+        ref.index = kAppend(cuboids_, static_cast<Cuboid const&>(object));
+        break;
+      case PrimitiveKind::kPlane:
+        ref.index = kAppend(planes_, static_cast<Plane const&>(object));
+        break;
+      case PrimitiveKind::kTriangle:
+        ref.index = kAppend(triangles_, static_cast<Triangle const&>(object));
+        break;
+      case PrimitiveKind::kMesh:
+        ref.index = kAppend(meshes_, std::static_pointer_cast<Mesh>(owner));
+        break;
+      default:
+        ref.index = kAppend(others_, owner);
+        break;
+    }
+  }
+}
+
+void GeometryStore::Update(
+    std::span<std::shared_ptr<Object> const> objects) {
+  for (size_t i = 0; i < objects.size(); ++i) {
+    auto const kRef = refs_[i];
+    auto const& object = *objects[i];
+    // meshes and other objects are kept by pointer, they moved already
+    switch (kRef.kind) {
+      case PrimitiveKind::kSphere:
+        spheres_[kRef.index] = static_cast<Sphere const&>(object);
+        break;
+      case PrimitiveKind::kCuboid:
+        cuboids_[kRef.index] = static_cast<Cuboid const&>(object);
+        break;
+      case PrimitiveKind::kPlane:
+        planes_[kRef.index] = static_cast<Plane const&>(object);
+        break;
+      case PrimitiveKind::kTriangle:
+        triangles_[kRef.index] = static_cast<Triangle const&>(object);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void GeometryStore::BindMaterials(MaterialTable& materials) {
+  auto const kBind = [&](auto& primitives) {
+    for (auto& primitive : primitives) primitive.BindMaterials(materials);
+  };
+  kBind(spheres_);
+  kBind(cuboids_);
+  kBind(planes_);
+  kBind(triangles_);
+  for (auto const& mesh : meshes_) mesh->BindMaterials(materials);
+  for (auto const& other : others_) other->BindMaterials(materials);
+}
+
+template <typename Self, typename Visitor>
+auto GeometryStore::Visit(Self& self, PrimitiveRef ref, Visitor&& visit)
+    -> decltype(auto) {
+  switch (ref.kind) {
+    case PrimitiveKind::kSphere:
+      return visit(self.spheres_[ref.index]);
+    case PrimitiveKind::kCuboid:
+      return visit(self.cuboids_[ref.index]);
+    case PrimitiveKind::kPlane:
+      return visit(self.planes_[ref.index]);
+    case PrimitiveKind::kTriangle:
+      return visit(self.triangles_[ref.index]);
+    case PrimitiveKind::kMesh:
+      return visit(*self.meshes_[ref.index]);
+    default:
+      return visit(*self.others_[ref.index]);
+  }
+}
+
+auto GeometryStore::Get(PrimitiveRef ref) -> Object& {
+  return Visit(*this, ref, [](Object& primitive) -> Object& {
+    return primitive;
+  });
+}
+
+auto GeometryStore::Get(PrimitiveRef ref) const -> Object const& {
+  return Visit(*this, ref, [](Object const& primitive) -> Object const& {
+    return primitive;
+  });
+}
+
+auto GeometryStore::Intersect(PrimitiveRef ref, Ray const& ray,
+                              HitRecord& record) const -> bool {
+  return Visit(*this, ref, [&](auto const& primitive) {
+    return primitive.Intersect(ray, record);
+  });
+}
+
+auto GeometryStore::IntersectP(PrimitiveRef ref, Ray const& ray) const
+    -> bool {
+  return Visit(*this, ref, [&](auto const& primitive) {
+    return primitive.IntersectP(ray);
+  });
+}
+}  // namespace cherry
@@ -0,0 +1,479 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : primitive_block.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 5:35
+// Description : SoA copies of the analytic primitives of BVH leaves
+
+#include "acceleration/primitive_block.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CHERRY_PRIMITIVE_BLOCK_SSE
+#endif
+
+#include "utility/constant.h"
+
+namespace cherry {
+namespace {
+// the kernels are written once over these lane types: plain doubles, and SSE2
+// and AVX registers where available
+struct Scalar {
+  static constexpr int kWidth = 1;
+  using Value = double;
+  using Mask = bool;
+  static auto Load(double const* p) -> Value { return *p; }
+  static auto Set(double v) -> Value { return v; }
+  static auto Sqrt(Value v) -> Value { return std::sqrt(v); }
+  static auto Abs(Value v) -> Value { return std::abs(v); }
+  static auto Lt(Value a, Value b) -> Mask { return a < b; }
+  static auto Le(Value a, Value b) -> Mask { return a <= b; }
+  static auto Gt(Value a, Value b) -> Mask { return a > b; }
+  static auto Ge(Value a, Value b) -> Mask { return a >= b; }
+  static auto And(Mask a, Mask b) -> Mask { return a && b; }
+  static auto Or(Mask a, Mask b) -> Mask { return a || b; }
+  // a where mask is set, b elsewhere
+  static auto Select(Mask mask, Value a, Value b) -> Value {
+    return mask ? a : b;
+  }
+  static auto Bits(Mask m) -> uint32_t { return m ? 1U : 0U; }
+  static void Store(double* p, Value v) { *p = v; }
+};
+
+#if defined(CHERRY_PRIMITIVE_BLOCK_SSE)
+struct Sse2 {
+  static constexpr int kWidth = 2;
+  struct Value {
+    __m128d v;
+    friend auto operator+(Value a, Value b) -> Value {
+      return {_mm_add_pd(a.v, b.v)};
+    }
+    friend auto operator-(Value a, Value b) -> Value {
+      return {_mm_sub_pd(a.v, b.v)};
+    }
+    friend auto operator*(Value a, Value b) -> Value {
+      return {_mm_mul_pd(a.v, b.v)};
+    }
+    friend auto operator/(Value a, Value b) -> Value {
+      return {_mm_div_pd(a.v, b.v)};
+    }
+  };
+  using Mask = __m128d;
+  static auto Load(double const* p) -> Value { return {_mm_loadu_pd(p)}; }
+  static auto Set(double v) -> Value { return {_mm_set1_pd(v)}; }
+  static auto Sqrt(Value v) -> Value { return {_mm_sqrt_pd(v.v)}; }
+  static auto Abs(Value v) -> Value {
+    return {_mm_andnot_pd(_mm_set1_pd(-0.0), v.v)};
+  }
+  static auto Lt(Value a, Value b) -> Mask { return _mm_cmplt_pd(a.v, b.v); }
+  static auto Le(Value a, Value b) -> Mask { return _mm_cmple_pd(a.v, b.v); }
+  static auto Gt(Value a, Value b) -> Mask { return _mm_cmpgt_pd(a.v, b.v); }
+  static auto Ge(Value a, Value b) -> Mask { return _mm_cmpge_pd(a.v, b.v); }
+  static auto And(Mask a, Mask b) -> Mask { return _mm_and_pd(a, b); }
+  static auto Or(Mask a, Mask b) -> Mask { return _mm_or_pd(a, b); }
+  static auto Select(Mask mask, Value a, Value b) -> Value {
+    return {_mm_or_pd(_mm_and_pd(mask, a.v), _mm_andnot_pd(mask, b.v))};
+  }
+  static auto Bits(Mask m) -> uint32_t {
+    return static_cast<uint32_t>(_mm_movemask_pd(m));
+  }
+  static void Store(double* p, Value v) { _mm_storeu_pd(p, v.v); }
+};
+#endif
+
+#if defined(__AVX__)
+struct Avx {
+  static constexpr int kWidth = 4;
+  struct Value {
+    __m256d v;
+    friend auto operator+(Value a, Value b) -> Value {
+      return {_mm256_add_pd(a.v, b.v)};
+    }
+    friend auto operator-(Value a, Value b) -> Value {
+      return {_mm256_sub_pd(a.v, b.v)};
+    }
+    friend auto operator*(Value a, Value b) -> Value {
+      return {_mm256_mul_pd(a.v, b.v)};
+    }
+    friend auto operator/(Value a, Value b) -> Value {
+      return {_mm256_div_pd(a.v, b.v)};
+    }
+  };
+  using Mask = __m256d;
+  static auto Load(double const* p) -> Value { return {_mm256_loadu_pd(p)}; }
+  static auto Set(double v) -> Value { return {_mm256_set1_pd(v)}; }
+  static auto Sqrt(Value v) -> Value { return {_mm256_sqrt_pd(v.v)}; }
+  static auto Abs(Value v) -> Value {
+    return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), v.v)};
+  }
+  static auto Lt(Value a, Value b) -> Mask {
+    return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ);
+  }
+  static auto Le(Value a, Value b) -> Mask {
+    return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ);
+  }
+  static auto Gt(Value a, Value b) -> Mask {
+    return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ);
+  }
+  static auto Ge(Value a, Value b) -> Mask {
+    return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ);
+  }
+  static auto And(Mask a, Mask b) -> Mask { return _mm256_and_pd(a, b); }
+  static auto Or(Mask a, Mask b) -> Mask { return _mm256_or_pd(a, b); }
+  static auto Select(Mask mask, Value a, Value b) -> Value {
+    return {_mm256_blendv_pd(b.v, a.v, mask)};
+  }
+  static auto Bits(Mask m) -> uint32_t {
+    return static_cast<uint32_t>(_mm256_movemask_pd(m));
+  }
+  static void Store(double* p, Value v) { _mm256_storeu_pd(p, v.v); }
+};
+using Lanes = Avx;
+#elif defined(CHERRY_PRIMITIVE_BLOCK_SSE)
+using Lanes = Sse2;
+#else
+using Lanes = Scalar;
+#endif
+
+constexpr int kLanes = Lanes::kWidth;
+using Value = Lanes::Value;
+using Mask = Lanes::Mask;
+
+// the lane masks of the first 0 to kLanes entries
+constexpr auto kCountMask = [] {
+  std::array<uint32_t, kLanes + 1> masks{};
+  for (int i = 0; i <= kLanes; ++i) masks[i] = (1U << i) - 1;
+  return masks;
+}();
+
+struct SplatRay {
+  std::array<Value, 3> origin;
+  std::array<Value, 3> direction;
+  std::array<Value, 3> direction_inv;
+  Value t_min;
+  Value t_max;
+};
+
+auto Splat(Ray const& ray) -> SplatRay {
+  SplatRay splat{};
+  for (int i = 0; i < 3; ++i) {
+    splat.origin[i] = Lanes::Set(ray.origin[i]);
+    splat.direction[i] = Lanes::Set(ray.direction[i]);
+    splat.direction_inv[i] = Lanes::Set(ray.direction_inv[i]);
+  }
+  splat.t_min = Lanes::Set(ray.t_min);
+  splat.t_max = Lanes::Set(ray.t_max);
+  return splat;
+}
+
+// x * y summed over the axes in the order of Vector3::Dot
+auto Dot(std::array<Value, 3> const& x, std::array<Value, 3> const& y)
+    -> Value {
+  return x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+}
+
+auto LoadAxes(std::vector<double> const& x, std::vector<double> const& y,
+              std::vector<double> const& z, uint32_t entry)
+    -> std::array<Value, 3> {
+  return {Lanes::Load(x.data() + entry), Lanes::Load(y.data() + entry),
+          Lanes::Load(z.data() + entry)};
+}
+
+// Sphere::HitDistance over the lanes of the spheres starting at entry
+auto SphereLanes(PrimitiveBlocks::SphereArrays const& spheres, uint32_t entry,
+                 Ray const& ray, SplatRay const& splat, Value& t) -> Mask {
+  auto const kCenter =
+      LoadAxes(spheres.center_x, spheres.center_y, spheres.center_z, entry);
+  std::array<Value, 3> const kL = {splat.origin[0] - kCenter[0],
+                                   splat.origin[1] - kCenter[1],
+                                   splat.origin[2] - kCenter[2]};
+  auto const kA = Lanes::Set(ray.direction.Norm2());
+  auto const kB = Lanes::Set(2.0) * Dot(splat.direction, kL);
+  auto const kC = Dot(kL, kL) - Lanes::Load(spheres.radius2.data() + entry);
+
+  // SolveQuadratic
+  auto const kDiscriminant = kB * kB - Lanes::Set(4.0) * kA * kC;
+  auto const kReal = Lanes::Ge(kDiscriminant, Lanes::Set(0.0));
+  // most spheres are missed, skip the roots like the scalar test does
+  if (Lanes::Bits(kReal) == 0) return kReal;
+  auto const kDouble =
+      Lanes::Lt(Lanes::Abs(kDiscriminant), Lanes::Set(EPSILON));
+  auto const kRoot = Lanes::Sqrt(kDiscriminant);
+  auto const kQ = Lanes::Set(-0.5) *
+                  Lanes::Select(Lanes::Gt(kB, Lanes::Set(0.0)), kB + kRoot,
+                                kB - kRoot);
+  auto const kDoubleRoot = Lanes::Set(-0.5) * kB / kA;
+  auto const kX0 = Lanes::Select(kDouble, kDoubleRoot, kQ / kA);
+  auto const kX1 = Lanes::Select(kDouble, kDoubleRoot, kC / kQ);
+  auto const kSwap = Lanes::Gt(kX0, kX1);
+  auto const kNear = Lanes::Select(kSwap, kX1, kX0);
+  auto const kFar = Lanes::Select(kSwap, kX0, kX1);
+
+  t = Lanes::Select(Lanes::Lt(kNear, splat.t_min), kFar, kNear);
+  return Lanes::And(kReal, Lanes::And(Lanes::Ge(t, splat.t_min),
+                                      Lanes::Le(t, splat.t_max)));
+}
+
+// Cuboid::HitDistance over the lanes of the cuboids starting at entry
+auto CuboidLanes(PrimitiveBlocks::CuboidArrays const& cuboids, uint32_t entry,
+                 SplatRay const& splat, Value& t) -> Mask {
+  auto const kMin = LoadAxes(cuboids.min_x, cuboids.min_y, cuboids.min_z,
+                             entry);
+  auto const kMax = LoadAxes(cuboids.max_x, cuboids.max_y, cuboids.max_z,
+                             entry);
+  std::array<Value, 3> t0{};
+  std::array<Value, 3> t1{};
+  for (int i = 0; i < 3; ++i) {
+    auto const kA = (kMin[i] - splat.origin[i]) * splat.direction_inv[i];
+    auto const kB = (kMax[i] - splat.origin[i]) * splat.direction_inv[i];
+    // std::min and std::max keep the first argument on ties
+    auto const kSwap = Lanes::Lt(kB, kA);
+    t0[i] = Lanes::Select(kSwap, kB, kA);
+    t1[i] = Lanes::Select(kSwap, kA, kB);
+  }
+  auto const kMax2 = [](Value a, Value b) {
+    return Lanes::Select(Lanes::Lt(a, b), b, a);
+  };
+  auto const kMin2 = [](Value a, Value b) {
+    return Lanes::Select(Lanes::Lt(b, a), b, a);
+  };
+  auto const kEnter = kMax2(kMax2(t0[0], t0[1]), t0[2]);
+  auto const kExit = kMin2(kMin2(t1[0], t1[1]), t1[2]);
+  t = kEnter;
+  auto const kHit = Lanes::And(Lanes::Lt(kEnter, kExit),
+                               Lanes::Ge(kExit, Lanes::Set(0.0)));
+  return Lanes::And(kHit, Lanes::And(Lanes::Ge(kEnter, splat.t_min),
+                                     Lanes::Le(kEnter, splat.t_max)));
+}
+
+// Plane::HitDistance over the lanes of the planes starting at entry
+auto PlaneLanes(PrimitiveBlocks::PlaneArrays const& planes, uint32_t entry,
+                SplatRay const& splat, Value& t) -> Mask {
+  auto const kNormal =
+      LoadAxes(planes.normal_x, planes.normal_y, planes.normal_z, entry);
+  auto const kPosition = LoadAxes(planes.position_x, planes.position_y,
+                                  planes.position_z, entry);
+  auto const kFacing =
+      Lanes::Le(Dot(splat.direction, kNormal), Lanes::Set(0.0));
+  std::array<Value, 3> const kToPlane = {kPosition[0] - splat.origin[0],
+                                         kPosition[1] - splat.origin[1],
+                                         kPosition[2] - splat.origin[2]};
+  t = Dot(kNormal, kToPlane) / Dot(kNormal, splat.direction);
+  auto hit = Lanes::And(
+      kFacing, Lanes::And(Lanes::Ge(t, splat.t_min),
+                          Lanes::Le(t, splat.t_max)));
+
+  // the hit point in the frame of the edges, for bounded planes
+  std::array<Value, 3> const kE = {
+      splat.origin[0] + splat.direction[0] * t - kPosition[0],
+      splat.origin[1] + splat.direction[1] * t - kPosition[1],
+      splat.origin[2] + splat.direction[2] * t - kPosition[2]};
+  auto const kT1 = Dot(kE, LoadAxes(planes.e1_x, planes.e1_y, planes.e1_z,
+                                    entry)) /
+                   Lanes::Load(planes.e1_norm2.data() + entry);
+  auto const kT2 = Dot(kE, LoadAxes(planes.e2_x, planes.e2_y, planes.e2_z,
+                                    entry)) /
+                   Lanes::Load(planes.e2_norm2.data() + entry);
+  auto const kZero = Lanes::Set(0.0);
+  auto const kOne = Lanes::Set(1.0);
+  auto const kInside =
+      Lanes::And(Lanes::And(Lanes::Ge(kT1, kZero), Lanes::Le(kT1, kOne)),
+                 Lanes::And(Lanes::Ge(kT2, kZero), Lanes::Le(kT2, kOne)));
+  auto const kUnbounded =
+      Lanes::Le(Lanes::Load(planes.bounded.data() + entry), kZero);
+  return Lanes::And(hit, Lanes::Or(kUnbounded, kInside));
+}
+
+// hit mask and distances of the lanes of a run starting at entry
+auto RunLanes(PrimitiveKind kind, PrimitiveBlocks::SphereArrays const& spheres,
+              PrimitiveBlocks::CuboidArrays const& cuboids,
+              PrimitiveBlocks::PlaneArrays const& planes, uint32_t entry,
+              Ray const& ray, SplatRay const& splat, uint32_t lanes,
+              std::array<double, kLanes>& t) -> uint32_t {
+  Value distance{};
+  Mask hit{};
+  switch (kind) {
+    case PrimitiveKind::kSphere:
+      hit = SphereLanes(spheres, entry, ray, splat, distance);
+      break;
+    case PrimitiveKind::kCuboid:
+      hit = CuboidLanes(cuboids, entry, splat, distance);
+      break;
+    default:
+      hit = PlaneLanes(planes, entry, splat, distance);
+      break;
+  }
+  Lanes::Store(t.data(), distance);
+  return Lanes::Bits(hit) & kCountMask[lanes];
+}
+
+auto HasKernel(PrimitiveKind kind) -> bool {
+  return kind <= PrimitiveKind::kPlane;
+}
+
+// slots of the run starting at begin that can share a kernel, at most end
+auto RunEnd(std::span<PrimitiveRef const> slots, uint32_t begin,
+            uint32_t end) -> uint32_t {
+  auto const kKind = slots[begin].kind;
+  if (!HasKernel(kKind)) return begin + 1;
+  auto i = begin + 1;
+  while (i < end && slots[i].kind == kKind) ++i;
+  return i;
+}
+
+template <typename T>
+void Pad(std::vector<T>& values) {
+  values.resize(values.size() + kLanes - 1);
+}
+}  // namespace
+
+void PrimitiveBlocks::Build(GeometryStore const& store,
+                            std::span<PrimitiveRef const> slots) {
+  spheres_ = {};
+  cuboids_ = {};
+  planes_ = {};
+  entries_.assign(slots.size(), 0);
+  auto const kAppendSphere = [&](Sphere const& sphere) {
+    spheres_.center_x.push_back(sphere.Center().x);
+    spheres_.center_y.push_back(sphere.Center().y);
+    spheres_.center_z.push_back(sphere.Center().z);
+    spheres_.radius2.push_back(sphere.Radius2());
+    return spheres_.radius2.size() - 1;
+  };
+  auto const kAppendCuboid = [&](Cuboid const& cuboid) {
+    cuboids_.min_x.push_back(cuboid.MinCorner().x);
+    cuboids_.min_y.push_back(cuboid.MinCorner().y);
+    cuboids_.min_z.push_back(cuboid.MinCorner().z);
+    cuboids_.max_x.push_back(cuboid.MaxCorner().x);
+    cuboids_.max_y.push_back(cuboid.MaxCorner().y);
+    cuboids_.max_z.push_back(cuboid.MaxCorner().z);
+    return cuboids_.min_x.size() - 1;
+  };
+  auto const kAppendPlane = [&](Plane const& plane) {
+    planes_.position_x.push_back(plane.Position().x);
+    planes_.position_y.push_back(plane.Position().y);
+    planes_.position_z.push_back(plane.Position().z);
+    planes_.normal_x.push_back(plane.Normal().x);
+    planes_.normal_y.push_back(plane.Normal().y);
+    planes_.normal_z.push_back(plane.Normal().z);
+    planes_.e1_x.push_back(plane.E1().x);
+    planes_.e1_y.push_back(plane.E1().y);
+    planes_.e1_z.push_back(plane.E1().z);
+    planes_.e1_norm2.push_back(plane.E1().Norm2());
+    planes_.e2_x.push_back(plane.E2().x);
+    planes_.e2_y.push_back(plane.E2().y);
+    planes_.e2_z.push_back(plane.E2().z);
+    planes_.e2_norm2.push_back(plane.E2().Norm2());
+    planes_.bounded.push_back(
+        plane.E1().Norm2() > EPSILON && plane.E2().Norm2() > EPSILON ? 1.0
+                                                                     : 0.0);
+    return planes_.bounded.size() - 1;
+  };
+  for (size_t i = 0; i < slots.size(); ++i) {
+    auto const kRef = slots[i];
+    size_t entry = 0;
+    switch (kRef.kind) {
+      case PrimitiveKind::kSphere:
+        entry = kAppendSphere(store.Spheres()[kRef.index]);
+        break;
+      case PrimitiveKind::kCuboid:
+        entry = kAppendCuboid(store.Cuboids()[kRef.index]);
+        break;
+      case PrimitiveKind::kPlane:
+        entry = kAppendPlane(store.Planes()[kRef.index]);
+        break;
+      default:
+        break;
+    }
+    entries_[i] = static_cast<uint32_t>(entry);
+  }
+  for (auto* values : {&spheres_.center_x, &spheres_.center_y,
+                       &spheres_.center_z, &spheres_.radius2})
+    Pad(*values);
+  for (auto* values : {&cuboids_.min_x, &cuboids_.min_y, &cuboids_.min_z,
+                       &cuboids_.max_x, &cuboids_.max_y, &cuboids_.max_z})
+    Pad(*values);
+  for (auto* values :
+       {&planes_.position_x, &planes_.position_y, &planes_.position_z,
+        &planes_.normal_x, &planes_.normal_y, &planes_.normal_z,
+        &planes_.e1_x, &planes_.e1_y, &planes_.e1_z, &planes_.e1_norm2,
+        &planes_.e2_x, &planes_.e2_y, &planes_.e2_z, &planes_.e2_norm2,
+        &planes_.bounded})
+    Pad(*values);
+}
+
+auto PrimitiveBlocks::Intersect(GeometryStore const& store,
+                                std::span<PrimitiveRef const> slots,
+                                uint32_t offset, uint32_t count, Ray& ray,
+                                HitRecord& record) const -> bool {
+  auto const kEnd = offset + count;
+  bool hit = false;
+  for (auto i = offset; i < kEnd;) {
+    auto const kRunEnd = RunEnd(slots, i, kEnd);
+    // kinds without a kernel, and lone primitives that are cheaper to test
+    // directly
+    if (kRunEnd - i == 1) {
+      if (store.Intersect(slots[i], ray, record)) {
+        ray.t_max = record.distance;
+        hit = true;
+      }
+      ++i;
+      continue;
+    }
+
+    auto splat = Splat(ray);
+    for (uint32_t lanes = 0; i < kRunEnd; i += lanes) {
+      lanes = std::min<uint32_t>(kRunEnd - i, kLanes);
+      std::array<double, kLanes> t{};
+      auto mask = RunLanes(slots[i].kind, spheres_, cuboids_, planes_,
+                           entries_[i], ray, splat, lanes, t);
+      if (mask == 0) continue;
+      // the nearest lane, the last one of equal distances like the scalar
+      // loop, which accepts hits at t_max
+      auto nearest = std::countr_zero(mask);
+      for (mask &= mask - 1; mask != 0; mask &= mask - 1) {
+        auto const kLane = std::countr_zero(mask);
+        if (t[kLane] <= t[nearest]) nearest = kLane;
+      }
+      record = {.distance = t[nearest],
+                .object = &store.Get(slots[i + nearest])};
+      ray.t_max = record.distance;
+      splat.t_max = Lanes::Set(ray.t_max);
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+auto PrimitiveBlocks::IntersectP(GeometryStore const& store,
+                                 std::span<PrimitiveRef const> slots,
+                                 uint32_t offset, uint32_t count,
+                                 Ray const& ray) const -> bool {
+  auto const kEnd = offset + count;
+  for (auto i = offset; i < kEnd;) {
+    auto const kRunEnd = RunEnd(slots, i, kEnd);
+    if (kRunEnd - i == 1) {
+      if (store.IntersectP(slots[i], ray)) return true;
+      ++i;
+      continue;
+    }
+    auto const kSplat = Splat(ray);
+    for (uint32_t lanes = 0; i < kRunEnd; i += lanes) {
+      lanes = std::min<uint32_t>(kRunEnd - i, kLanes);
+      std::array<double, kLanes> t{};
+      if (RunLanes(slots[i].kind, spheres_, cuboids_, planes_, entries_[i],
+                   ray, kSplat, lanes, t) != 0)
+        return true;
+    }
+  }
+  return false;
+}
+}  // namespace cherry
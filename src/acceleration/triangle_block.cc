@@ -0,0 +1,297 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : triangle_block.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 4:20
+// Description : SoA triangle blocks tested with one SIMD kernel
+
+#include "acceleration/triangle_block.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CHERRY_TRIANGLE_BLOCK_SSE
+#endif
+
+namespace cherry {
+namespace {
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+// error allowed for, relative to the magnitudes of the inputs. Rounding the
+// inputs to float and the dozen operations after it stay below 16 ulp, this
+// leaves a wide margin and costs only the odd grazing candidate.
+constexpr float kTolerance = 0x1p-16F;
+
+auto RoundDown(double v) -> float {
+  auto const kF = static_cast<float>(v);
+  return kF > v ? std::nextafter(kF, -kInfinity) : kF;
+}
+
+auto RoundUp(double v) -> float {
+  auto const kF = static_cast<float>(v);
+  return kF < v ? std::nextafter(kF, kInfinity) : kF;
+}
+
+// per block constants of the kernel, broadcast to every lane
+struct BlockConstants {
+  std::array<float, 3> origin;
+  float det_error;
+  float uv_error;
+  float t_error;
+  float t_min;
+  float t_max;
+};
+
+// the kernel is written once over these lane types: plain floats, and SSE
+// and AVX registers where available
+struct Scalar {
+  static constexpr int kWidth = 1;
+  using Value = float;
+  using Mask = bool;
+  static auto Load(float const* p) -> Value { return *p; }
+  static auto Set(float v) -> Value { return v; }
+  static auto Ge(Value a, Value b) -> Mask { return a >= b; }
+  static auto Le(Value a, Value b) -> Mask { return a <= b; }
+  static auto And(Mask a, Mask b) -> Mask { return a && b; }
+  static auto Or(Mask a, Mask b) -> Mask { return a || b; }
+  static auto Bits(Mask m) -> uint32_t { return m ? 1U : 0U; }
+};
+
+#if defined(CHERRY_TRIANGLE_BLOCK_SSE)
+struct Sse {
+  static constexpr int kWidth = 4;
+  struct Value {
+    __m128 v;
+    friend auto operator+(Value a, Value b) -> Value {
+      return {_mm_add_ps(a.v, b.v)};
+    }
+    friend auto operator-(Value a, Value b) -> Value {
+      return {_mm_sub_ps(a.v, b.v)};
+    }
+    friend auto operator*(Value a, Value b) -> Value {
+      return {_mm_mul_ps(a.v, b.v)};
+    }
+  };
+  using Mask = __m128;
+  static auto Load(float const* p) -> Value { return {_mm_load_ps(p)}; }
+  static auto Set(float v) -> Value { return {_mm_set1_ps(v)}; }
+  static auto Ge(Value a, Value b) -> Mask { return _mm_cmpge_ps(a.v, b.v); }
+  static auto Le(Value a, Value b) -> Mask { return _mm_cmple_ps(a.v, b.v); }
+  static auto And(Mask a, Mask b) -> Mask { return _mm_and_ps(a, b); }
+  static auto Or(Mask a, Mask b) -> Mask { return _mm_or_ps(a, b); }
+  static auto Bits(Mask m) -> uint32_t {
+    return static_cast<uint32_t>(_mm_movemask_ps(m));
+  }
+};
+#endif
+
+#if defined(__AVX__)
+struct Avx {
+  static constexpr int kWidth = 8;
+  struct Value {
+    __m256 v;
+    friend auto operator+(Value a, Value b) -> Value {
+      return {_mm256_add_ps(a.v, b.v)};
+    }
+    friend auto operator-(Value a, Value b) -> Value {
+      return {_mm256_sub_ps(a.v, b.v)};
+    }
+    friend auto operator*(Value a, Value b) -> Value {
+      return {_mm256_mul_ps(a.v, b.v)};
+    }
+  };
+  using Mask = __m256;
+  static auto Load(float const* p) -> Value { return {_mm256_load_ps(p)}; }
+  static auto Set(float v) -> Value { return {_mm256_set1_ps(v)}; }
+  static auto Ge(Value a, Value b) -> Mask {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ);
+  }
+  static auto Le(Value a, Value b) -> Mask {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ);
+  }
+  static auto And(Mask a, Mask b) -> Mask { return _mm256_and_ps(a, b); }
+  static auto Or(Mask a, Mask b) -> Mask { return _mm256_or_ps(a, b); }
+  static auto Bits(Mask m) -> uint32_t {
+    return static_cast<uint32_t>(_mm256_movemask_ps(m));
+  }
+};
+#endif
+
+// candidate mask of the Lanes::kWidth lanes starting at base
+template <typename Lanes, int kWidth>
+auto TestLanes(TriangleBlock<kWidth> const& block, int base,
+               TriangleBlockRay const& ray, BlockConstants const& constants)
+    -> uint32_t {
+  using Value = typename Lanes::Value;
+  auto const kLoad = [base](std::array<float, kWidth> const& values) {
+    return Lanes::Load(values.data() + base);
+  };
+  Value const kDx = Lanes::Set(ray.direction[0]);
+  Value const kDy = Lanes::Set(ray.direction[1]);
+  Value const kDz = Lanes::Set(ray.direction[2]);
+  Value const kE1x = kLoad(block.e1_x);
+  Value const kE1y = kLoad(block.e1_y);
+  Value const kE1z = kLoad(block.e1_z);
+  Value const kE2x = kLoad(block.e2_x);
+  Value const kE2y = kLoad(block.e2_y);
+  Value const kE2z = kLoad(block.e2_z);
+
+  Value const kPx = kDy * kE2z - kDz * kE2y;
+  Value const kPy = kDz * kE2x - kDx * kE2z;
+  Value const kPz = kDx * kE2y - kDy * kE2x;
+  Value const kDet = kE1x * kPx + kE1y * kPy + kE1z * kPz;
+
+  Value const kTx = Lanes::Set(constants.origin[0]) - kLoad(block.v0_x);
+  Value const kTy = Lanes::Set(constants.origin[1]) - kLoad(block.v0_y);
+  Value const kTz = Lanes::Set(constants.origin[2]) - kLoad(block.v0_z);
+  Value const kU = kTx * kPx + kTy * kPy + kTz * kPz;
+  Value const kQx = kTy * kE1z - kTz * kE1y;
+  Value const kQy = kTz * kE1x - kTx * kE1z;
+  Value const kQz = kTx * kE1y - kTy * kE1x;
+  Value const kV = kDx * kQx + kDy * kQy + kDz * kQz;
+  Value const kT = kE2x * kQx + kE2y * kQy + kE2z * kQz;
+
+  // unnormalized, so that the tests hold for the exact values whenever they
+  // hold for the rounded ones widened by their error
+  Value const kDetError = Lanes::Set(constants.det_error);
+  Value const kUvError = Lanes::Set(constants.uv_error);
+  Value const kTError = Lanes::Set(constants.t_error);
+  Value const kZero = Lanes::Set(0.0F);
+  auto const kFront = Lanes::Ge(kDet + kDetError, kZero);
+  // the sign of the determinant is uncertain, leave the lane to the caller
+  auto const kGrazing = Lanes::Le(kDet, kDetError);
+  auto inside = Lanes::And(Lanes::Ge(kU + kUvError, kZero),
+                           Lanes::Ge(kV + kUvError, kZero));
+  inside = Lanes::And(
+      inside, Lanes::Le(kU + kV, kDet + kDetError + kUvError + kUvError));
+  inside = Lanes::And(
+      inside, Lanes::Ge(kT + kTError,
+                        Lanes::Set(constants.t_min) * (kDet - kDetError)));
+  inside = Lanes::And(
+      inside, Lanes::Le(kT - kTError,
+                        Lanes::Set(constants.t_max) * (kDet + kDetError)));
+  return Lanes::Bits(Lanes::And(kFront, Lanes::Or(kGrazing, inside)));
+}
+}  // namespace
+
+auto MakeTriangleBlockRay(Ray const& ray) -> TriangleBlockRay {
+  TriangleBlockRay block_ray{};
+  block_ray.origin = ray.origin;
+  double norm = 0;
+  for (int i = 0; i < 3; ++i) {
+    block_ray.direction[i] = static_cast<float>(ray.direction[i]);
+    norm += std::abs(ray.direction[i]);
+  }
+  block_ray.direction_norm = RoundUp(norm);
+  // the kernel scales the interval by an uncertain positive determinant,
+  // which only bounds t from the right side for nonnegative limits
+  block_ray.t_min = ray.t_min >= 0 ? RoundDown(ray.t_min) : -kInfinity;
+  return block_ray;
+}
+
+template <int kLanes>
+auto MakeTriangleBlock(std::span<std::array<math::Point3, 3> const> triangles)
+    -> TriangleBlock<kLanes> {
+  TriangleBlock<kLanes> block{};
+  auto const kCount = std::min<size_t>(triangles.size(), kLanes);
+  if (kCount == 0) return block;
+
+  // the centre of the bounds keeps the stored vertices smallest
+  auto lo = triangles[0][0];
+  auto hi = lo;
+  for (size_t i = 0; i < kCount; ++i) {
+    for (auto const& vertex : triangles[i]) {
+      for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = std::min(lo[axis], vertex[axis]);
+        hi[axis] = std::max(hi[axis], vertex[axis]);
+      }
+    }
+  }
+  block.origin = (lo + hi) * 0.5;
+
+  std::array<std::array<float, kLanes>*, 3> const kV0Lanes = {
+      &block.v0_x, &block.v0_y, &block.v0_z};
+  std::array<std::array<float, kLanes>*, 3> const kE1Lanes = {
+      &block.e1_x, &block.e1_y, &block.e1_z};
+  std::array<std::array<float, kLanes>*, 3> const kE2Lanes = {
+      &block.e2_x, &block.e2_y, &block.e2_z};
+  double extent = 0;
+  for (size_t i = 0; i < kCount; ++i) {
+    auto const& [v0, v1, v2] = triangles[i];
+    std::array<double, 3> norms{};
+    for (int axis = 0; axis < 3; ++axis) {
+      auto const kV0 = v0[axis] - block.origin[axis];
+      auto const kE1 = v1[axis] - v0[axis];
+      auto const kE2 = v2[axis] - v0[axis];
+      (*kV0Lanes[axis])[i] = static_cast<float>(kV0);
+      (*kE1Lanes[axis])[i] = static_cast<float>(kE1);
+      (*kE2Lanes[axis])[i] = static_cast<float>(kE2);
+      norms[0] += std::abs(kV0);
+      norms[1] += std::abs(kE1);
+      norms[2] += std::abs(kE2);
+    }
+    extent = std::max({extent, norms[0], norms[1], norms[2]});
+  }
+  block.extent = RoundUp(extent);
+  return block;
+}
+
+template <int kLanes>
+auto TriangleBlockCandidates(TriangleBlock<kLanes> const& block,
+                             TriangleBlockRay const& ray, double t_max,
+                             int count) -> uint32_t {
+  // the origin relative to the block is rounded once. Rounding the limits and
+  // the bounds below to nearest is covered by the margin of kTolerance.
+  BlockConstants constants{};
+  float origin_norm = 0;
+  for (int i = 0; i < 3; ++i) {
+    constants.origin[i] = static_cast<float>(ray.origin[i] - block.origin[i]);
+    origin_norm += std::abs(constants.origin[i]);
+  }
+  // first order error bounds of det, u and v, and the t numerator, from the
+  // magnitudes of the vectors they are products of
+  auto const kExtent = block.extent;
+  auto const kOriginExtent = origin_norm + kExtent;
+  auto const kDirection = ray.direction_norm;
+  constants.det_error = kTolerance * kDirection * kExtent * kExtent;
+  constants.uv_error = kTolerance * kDirection * kOriginExtent * kExtent;
+  constants.t_error = kTolerance * kOriginExtent * kExtent * kExtent;
+  constants.t_min = ray.t_min;
+  constants.t_max = static_cast<float>(std::max(t_max, 0.0));
+
+  uint32_t mask = 0;
+#if defined(__AVX__)
+  if constexpr (kLanes == 8) {
+    mask = TestLanes<Avx>(block, 0, ray, constants);
+  } else
+#endif
+  {
+#if defined(CHERRY_TRIANGLE_BLOCK_SSE)
+    using Lanes = Sse;
+#else
+    using Lanes = Scalar;
+#endif
+    for (int base = 0; base < kLanes; base += Lanes::kWidth)
+      mask |= TestLanes<Lanes>(block, base, ray, constants) << base;
+  }
+  return mask & ((1U << count) - 1);
+}
+
+template auto MakeTriangleBlock<4>(
+    std::span<std::array<math::Point3, 3> const> triangles)
+    -> TriangleBlock<4>;
+template auto MakeTriangleBlock<8>(
+    std::span<std::array<math::Point3, 3> const> triangles)
+    -> TriangleBlock<8>;
+template auto TriangleBlockCandidates(TriangleBlock<4> const& block,
+                                      TriangleBlockRay const& ray,
+                                      double t_max, int count) -> uint32_t;
+template auto TriangleBlockCandidates(TriangleBlock<8> const& block,
+                                      TriangleBlockRay const& ray,
+                                      double t_max, int count) -> uint32_t;
+}  // namespace cherry
@@ -0,0 +1,495 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : wide_bvh.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 16:37
+// Description :
+
+#include "acceleration/wide_bvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <span>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CHERRY_WIDE_BVH_SSE
+#endif
+
+#include "acceleration/bvh.h"
+
+namespace cherry {
+namespace {
+// every wide level consumes at least one binary level and pushes at most
+// kWidth - 1 entries beyond its own
+template <int kWidth>
+constexpr int kWideStackSize = kMaxBvhDepth * (kWidth - 1) + 1;
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+constexpr float kHalfEpsilon = std::numeric_limits<float>::epsilon() * 0.5F;
+constexpr float kSlabRobustness =
+    1 + 2 * (3 * kHalfEpsilon) / (1 - 3 * kHalfEpsilon);
+// relative padding of the float bounds, a margin for the nudged directions
+// and for boxes that are flat along an axis
+constexpr double kBoundsPadding = 1.0 / (1 << 22);
+// direction components below this are nudged so the inverse stays finite
+constexpr double kMinDirection = 1e-20;
+// compressed nodes clamp their bounds to this so that the scale stays finite,
+// nothing that far out is ever hit
+constexpr double kQuantizedLimit = 0x1p100;
+// steps the scale spans over the node extent, leaving one step each for
+// rounding the origin down and the planes outwards
+constexpr double kQuantizedSpan = 253;
+constexpr int kMinQuantizedExponent = -100;
+
+auto RoundDown(double v) -> float {
+  auto const kF = static_cast<float>(v);
+  return kF > v ? std::nextafter(kF, -kInfinity) : kF;
+}
+
+auto RoundUp(double v) -> float {
+  auto const kF = static_cast<float>(v);
+  return kF < v ? std::nextafter(kF, kInfinity) : kF;
+}
+
+// the origin is rounded both ways: min planes are tested against origin_up
+// and max planes against origin_down, which widens every slab by the rounding
+// of the origin whatever the direction
+struct WideRay {
+  std::array<float, 3> origin_down;
+  std::array<float, 3> origin_up;
+  std::array<float, 3> inv_dir;
+  float t_min;
+};
+
+struct WideStackEntry {
+  uint32_t offset;
+  uint16_t count;
+  float t;
+};
+
+auto MakeWideRay(Ray const& ray) -> WideRay {
+  WideRay wide{};
+  for (int i = 0; i < 3; ++i) {
+    wide.origin_down[i] = RoundDown(ray.origin[i]);
+    wide.origin_up[i] = RoundUp(ray.origin[i]);
+    auto direction = ray.direction[i];
+    if (std::abs(direction) < kMinDirection)
+      direction = std::copysign(kMinDirection, direction);
+    wide.inv_dir[i] = static_cast<float>(1.0 / direction);
+  }
+  wide.t_min = RoundDown(ray.t_min);
+  return wide;
+}
+
+// half the float range, so that widening the exit distance cannot overflow
+// to the +inf of the empty lanes
+auto WideTMax(Ray const& ray) -> float {
+  return RoundUp(std::min(ray.t_max,
+                          double{std::numeric_limits<float>::max() / 2}));
+}
+
+template <int kWidth>
+void SetLane(WideBvhNode<kWidth>& node, int lane, Box const& bounds) {
+  std::array<std::array<float, kWidth>*, 3> const kMin = {
+      &node.min_x, &node.min_y, &node.min_z};
+  std::array<std::array<float, kWidth>*, 3> const kMax = {
+      &node.max_x, &node.max_y, &node.max_z};
+  for (int i = 0; i < 3; ++i) {
+    auto const kPad =
+        (std::abs(bounds.min[i]) + std::abs(bounds.max[i])) * kBoundsPadding;
+    (*kMin[i])[lane] = RoundDown(bounds.min[i] - kPad);
+    (*kMax[i])[lane] = RoundUp(bounds.max[i] + kPad);
+  }
+}
+
+template <int kWidth>
+void ClearLane(WideBvhNode<kWidth>& node, int lane) {
+  for (auto* values : {&node.min_x, &node.min_y, &node.min_z, &node.max_x,
+                       &node.max_y, &node.max_z})
+    (*values)[lane] = kInfinity;
+  node.offset[lane] = 0;
+  node.count[lane] = 0;
+}
+
+template <int kWidth>
+void SetBounds(WideBvhNode<kWidth>& node, std::span<Box const> children) {
+  for (int i = 0; i < kWidth; ++i) {
+    if (i < static_cast<int>(children.size()))
+      SetLane(node, i, children[i]);
+    else
+      ClearLane(node, i);
+  }
+}
+
+/**
+ * @brief Exponent of the power of two scale a compressed node quantizes the
+ * axis range [lo, hi] with. The scale is coarse enough that the planes fit in
+ * 8 bits and that origin + q * scale stays an exact float.
+ */
+auto QuantizedExponent(double lo, double hi) -> int {
+  auto const kNeeded =
+      std::max((hi - lo) / kQuantizedSpan,
+               std::max(std::abs(lo), std::abs(hi)) * 0x1p-23);
+  if (!(kNeeded > 0)) return kMinQuantizedExponent;
+  int exponent = 0;
+  std::frexp(kNeeded, &exponent);  // 2^exponent > kNeeded
+  return std::max(exponent, kMinQuantizedExponent);
+}
+
+// 2^exponent for the exponents QuantizedExponent returns
+auto Exp2(int exponent) -> float {
+  return std::bit_cast<float>(static_cast<uint32_t>(exponent + 127) << 23);
+}
+
+template <int kWidth>
+void SetBounds(CompressedBvhNode<kWidth>& node,
+               std::span<Box const> children) {
+  // quantize the float planes of the uncompressed layout, so both are
+  // padded the same way
+  WideBvhNode<kWidth> planes{};
+  SetBounds(planes, children);
+  auto const kCount = static_cast<int>(children.size());
+  node.child_count = static_cast<uint8_t>(kCount);
+
+  std::array<std::array<float, kWidth> const*, 3> const kMin = {
+      &planes.min_x, &planes.min_y, &planes.min_z};
+  std::array<std::array<float, kWidth> const*, 3> const kMax = {
+      &planes.max_x, &planes.max_y, &planes.max_z};
+  std::array<std::array<uint8_t, kWidth>*, 3> const kQuantizedMin = {
+      &node.min_x, &node.min_y, &node.min_z};
+  std::array<std::array<uint8_t, kWidth>*, 3> const kQuantizedMax = {
+      &node.max_x, &node.max_y, &node.max_z};
+  auto const kClamp = [](float v) {
+    return std::clamp(double{v}, -kQuantizedLimit, kQuantizedLimit);
+  };
+  for (int axis = 0; axis < 3; ++axis) {
+    auto lo = kQuantizedLimit;
+    auto hi = -kQuantizedLimit;
+    for (int i = 0; i < kCount; ++i) {
+      lo = std::min(lo, kClamp((*kMin[axis])[i]));
+      hi = std::max(hi, kClamp((*kMax[axis])[i]));
+    }
+    auto const kExponent = QuantizedExponent(lo, hi);
+    auto const kScale = std::ldexp(1.0, kExponent);
+    auto const kBase = std::floor(lo / kScale);
+    node.origin[axis] = static_cast<float>(kBase * kScale);
+    node.exponent[axis] = static_cast<int8_t>(kExponent);
+    for (int i = 0; i < kWidth; ++i) {
+      if (i >= kCount) {
+        (*kQuantizedMin[axis])[i] = 0;
+        (*kQuantizedMax[axis])[i] = 0;
+        continue;
+      }
+      (*kQuantizedMin[axis])[i] = static_cast<uint8_t>(
+          std::floor(kClamp((*kMin[axis])[i]) / kScale) - kBase);
+      (*kQuantizedMax[axis])[i] = static_cast<uint8_t>(
+          std::ceil(kClamp((*kMax[axis])[i]) / kScale) - kBase);
+    }
+  }
+}
+
+template <int kWidth>
+void Decode(CompressedBvhNode<kWidth> const& node,
+            WideBvhNode<kWidth>& planes) {
+  std::array<std::array<uint8_t, kWidth> const*, 3> const kQuantizedMin = {
+      &node.min_x, &node.min_y, &node.min_z};
+  std::array<std::array<uint8_t, kWidth> const*, 3> const kQuantizedMax = {
+      &node.max_x, &node.max_y, &node.max_z};
+  std::array<std::array<float, kWidth>*, 3> const kMin = {
+      &planes.min_x, &planes.min_y, &planes.min_z};
+  std::array<std::array<float, kWidth>*, 3> const kMax = {
+      &planes.max_x, &planes.max_y, &planes.max_z};
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const kOrigin = node.origin[axis];
+    auto const kScale = Exp2(node.exponent[axis]);
+#if defined(CHERRY_WIDE_BVH_SSE)
+    auto const kDecode = [&](uint8_t const* quantized, float* plane) {
+      auto const kZero = _mm_setzero_si128();
+      for (int base = 0; base < kWidth; base += 4) {
+        int32_t packed = 0;
+        std::memcpy(&packed, quantized + base, sizeof(packed));
+        auto const kLanes = _mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), kZero), kZero);
+        _mm_store_ps(plane + base,
+                     _mm_add_ps(_mm_set1_ps(kOrigin),
+                                _mm_mul_ps(_mm_cvtepi32_ps(kLanes),
+                                           _mm_set1_ps(kScale))));
+      }
+    };
+    kDecode(kQuantizedMin[axis]->data(), kMin[axis]->data());
+    kDecode(kQuantizedMax[axis]->data(), kMax[axis]->data());
+#else
+    for (int i = 0; i < kWidth; ++i) {
+      (*kMin[axis])[i] =
+          kOrigin + static_cast<float>((*kQuantizedMin[axis])[i]) * kScale;
+      (*kMax[axis])[i] =
+          kOrigin + static_cast<float>((*kQuantizedMax[axis])[i]) * kScale;
+    }
+#endif
+  }
+}
+
+#if defined(CHERRY_WIDE_BVH_SSE)
+// slab test of the four lanes starting at base
+template <int kWidth>
+auto SlabTest4(WideBvhNode<kWidth> const& node, int base, WideRay const& ray,
+               float t_max, float* t_near) -> uint32_t {
+  auto const kSlab = [&](float const* min, float const* max, int axis,
+                         __m128& t0, __m128& t1) {
+    auto const kInvDir = _mm_set1_ps(ray.inv_dir[axis]);
+    auto const kA = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(min + base),
+                                          _mm_set1_ps(ray.origin_up[axis])),
+                               kInvDir);
+    auto const kB = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(max + base),
+                                          _mm_set1_ps(ray.origin_down[axis])),
+                               kInvDir);
+    t0 = _mm_max_ps(t0, _mm_min_ps(kA, kB));
+    t1 = _mm_min_ps(t1, _mm_max_ps(kA, kB));
+  };
+  auto t0 = _mm_set1_ps(ray.t_min);
+  auto t1 = _mm_set1_ps(t_max);
+  kSlab(node.min_x.data(), node.max_x.data(), 0, t0, t1);
+  kSlab(node.min_y.data(), node.max_y.data(), 1, t0, t1);
+  kSlab(node.min_z.data(), node.max_z.data(), 2, t0, t1);
+  t1 = _mm_mul_ps(t1, _mm_set1_ps(kSlabRobustness));
+  _mm_storeu_ps(t_near, t0);
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t0, t1)));
+}
+#endif
+
+/**
+ * @brief Test the ray against all child boxes of a node
+ *
+ * @param t_near entry distance of every lane
+ * @return bit mask of the lanes the ray enters within [t_min, t_max]
+ */
+template <int kWidth>
+auto SlabTest(WideBvhNode<kWidth> const& node, WideRay const& ray,
+              float t_max, float* t_near) -> uint32_t {
+#if defined(__AVX__)
+  if constexpr (kWidth == 8) {
+    auto const kSlab = [&](float const* min, float const* max, int axis,
+                           __m256& t0, __m256& t1) {
+      auto const kInvDir = _mm256_set1_ps(ray.inv_dir[axis]);
+      auto const kA = _mm256_mul_ps(
+          _mm256_sub_ps(_mm256_load_ps(min),
+                        _mm256_set1_ps(ray.origin_up[axis])),
+          kInvDir);
+      auto const kB = _mm256_mul_ps(
+          _mm256_sub_ps(_mm256_load_ps(max),
+                        _mm256_set1_ps(ray.origin_down[axis])),
+          kInvDir);
+      t0 = _mm256_max_ps(t0, _mm256_min_ps(kA, kB));
+      t1 = _mm256_min_ps(t1, _mm256_max_ps(kA, kB));
+    };
+    auto t0 = _mm256_set1_ps(ray.t_min);
+    auto t1 = _mm256_set1_ps(t_max);
+    kSlab(node.min_x.data(), node.max_x.data(), 0, t0, t1);
+    kSlab(node.min_y.data(), node.max_y.data(), 1, t0, t1);
+    kSlab(node.min_z.data(), node.max_z.data(), 2, t0, t1);
+    t1 = _mm256_mul_ps(t1, _mm256_set1_ps(kSlabRobustness));
+    _mm256_storeu_ps(t_near, t0);
+    return static_cast<uint32_t>(
+        _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)));
+  }
+#endif
+#if defined(CHERRY_WIDE_BVH_SSE)
+  uint32_t mask = 0;
+  for (int base = 0; base < kWidth; base += 4)
+    mask |= SlabTest4(node, base, ray, t_max, t_near + base) << base;
+  return mask;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < kWidth; ++i) {
+    auto const kX0 = (node.min_x[i] - ray.origin_up[0]) * ray.inv_dir[0];
+    auto const kX1 =
+        (node.max_x[i] - ray.origin_down[0]) * ray.inv_dir[0];
+    auto const kY0 = (node.min_y[i] - ray.origin_up[1]) * ray.inv_dir[1];
+    auto const kY1 =
+        (node.max_y[i] - ray.origin_down[1]) * ray.inv_dir[1];
+    auto const kZ0 = (node.min_z[i] - ray.origin_up[2]) * ray.inv_dir[2];
+    auto const kZ1 =
+        (node.max_z[i] - ray.origin_down[2]) * ray.inv_dir[2];
+    auto const kT0 = std::max({std::min(kX0, kX1), std::min(kY0, kY1),
+                               std::min(kZ0, kZ1), ray.t_min});
+    auto const kT1 = std::min({std::max(kX0, kX1), std::max(kY0, kY1),
+                               std::max(kZ0, kZ1), t_max}) *
+                     kSlabRobustness;
+    t_near[i] = kT0;
+    mask |= static_cast<uint32_t>(kT0 <= kT1) << i;
+  }
+  return mask;
+#endif
+}
+
+// decodes the planes and tests them like an uncompressed node
+template <int kWidth>
+auto SlabTest(CompressedBvhNode<kWidth> const& node, WideRay const& ray,
+              float t_max, float* t_near) -> uint32_t {
+  WideBvhNode<kWidth> planes;
+  Decode(node, planes);
+  return SlabTest(planes, ray, t_max, t_near) &
+         ((1U << node.child_count) - 1);
+}
+}  // namespace
+
+template <typename Node>
+void Bvh::Collapse(std::vector<Node>& wide) const {
+  wide.clear();
+  wide.reserve(nodes_.size() / (Node::kWidth - 1) + 1);
+  CollapseNode(0, wide);
+}
+
+template <typename Node>
+auto Bvh::CollapseNode(uint32_t index, std::vector<Node>& wide) const
+    -> uint32_t {
+  constexpr int kWidth = Node::kWidth;
+  auto const kWideIndex = static_cast<uint32_t>(wide.size());
+  wide.emplace_back();
+
+  std::array<uint32_t, kWidth> children{};
+  int child_count = 0;
+  if (nodes_[index].primitive_count > 0) {
+    children[child_count++] = index;
+  } else {
+    children[child_count++] = nodes_[index].first_child_offset;
+    children[child_count++] = nodes_[index].second_child_offset;
+  }
+
+  // keep opening the largest interior child until the node is full
+  while (child_count < kWidth) {
+    auto best = -1;
+    auto best_area = -1.0;
+    for (int i = 0; i < child_count; ++i) {
+      auto const& child = nodes_[children[i]];
+      if (child.primitive_count == 0 &&
+          child.bounds.SurfaceArea() > best_area) {
+        best = i;
+        best_area = child.bounds.SurfaceArea();
+      }
+    }
+    if (best < 0) break;
+
+    auto const kOpened = children[best];
+    children[best] = nodes_[kOpened].first_child_offset;
+    children[child_count++] = nodes_[kOpened].second_child_offset;
+  }
+
+  // wide may grow while collapsing the children, so fill a local copy
+  Node node{};
+  std::array<Box, kWidth> bounds{};
+  for (int i = 0; i < child_count; ++i) {
+    auto const& child = nodes_[children[i]];
+    bounds[i] = child.bounds;
+    if (child.primitive_count > 0) {
+      node.offset[i] = child.primitives_offset;
+      node.count[i] = child.primitive_count;
+    } else {
+      node.offset[i] = CollapseNode(children[i], wide);
+      node.count[i] = 0;
+    }
+  }
+  SetBounds(node, std::span<Box const>(bounds.data(), child_count));
+  wide[kWideIndex] = node;
+  return kWideIndex;
+}
+
+template <typename Node>
+auto Bvh::IntersectWide(std::span<Node const> wide, Ray const& ray,
+                        HitRecord& record) const -> bool {
+  constexpr int kWidth = Node::kWidth;
+  Ray closest = ray;
+  auto const kRay = MakeWideRay(ray);
+  bool hit = false;
+
+  std::array<WideStackEntry, kWideStackSize<kWidth>> stack{};
+  int stack_size = 0;
+  stack[stack_size++] = {0, 0, kRay.t_min};
+  while (stack_size > 0) {
+    auto const kEntry = stack[--stack_size];
+    if (kEntry.t > closest.t_max) continue;
+
+    if (kEntry.count > 0) {
+      hit |= IntersectLeaf(kEntry.offset, kEntry.count, closest, record);
+      continue;
+    }
+
+    auto const& node = wide[kEntry.offset];
+    std::array<float, kWidth> t_near{};
+    auto mask = SlabTest(node, kRay, WideTMax(closest), t_near.data());
+
+    // sort the entered children by distance, then push the farthest first
+    std::array<int, kWidth> order{};
+    int hits = 0;
+    for (; mask != 0; mask &= mask - 1) {
+      auto const kLane = std::countr_zero(mask);
+      auto j = hits++;
+      for (; j > 0 && t_near[order[j - 1]] > t_near[kLane]; --j)
+        order[j] = order[j - 1];
+      order[j] = kLane;
+    }
+    for (int i = hits - 1; i >= 0; --i) {
+      auto const kLane = order[i];
+      stack[stack_size++] = {node.offset[kLane], node.count[kLane],
+                             t_near[kLane]};
+    }
+  }
+  return hit;
+}
+
+template <typename Node>
+auto Bvh::IntersectAnyWide(std::span<Node const> wide, Ray const& ray) const
+    -> bool {
+  constexpr int kWidth = Node::kWidth;
+  auto const kRay = MakeWideRay(ray);
+  auto const kTMax = WideTMax(ray);
+
+  std::array<WideStackEntry, kWideStackSize<kWidth>> stack{};
+  int stack_size = 0;
+  stack[stack_size++] = {0, 0, kRay.t_min};
+  while (stack_size > 0) {
+    auto const kEntry = stack[--stack_size];
+    if (kEntry.count > 0) {
+      if (IntersectLeafAny(kEntry.offset, kEntry.count, ray)) return true;
+      continue;
+    }
+
+    auto const& node = wide[kEntry.offset];
+    std::array<float, kWidth> t_near{};
+    for (auto mask = SlabTest(node, kRay, kTMax, t_near.data()); mask != 0;
+         mask &= mask - 1) {
+      auto const kLane = std::countr_zero(mask);
+      stack[stack_size++] = {node.offset[kLane], node.count[kLane],
+                             t_near[kLane]};
+    }
+  }
+  return false;
+}
+
+template void Bvh::Collapse(std::vector<WideBvhNode<4>>&) const;
+template auto Bvh::IntersectWide(std::span<WideBvhNode<4> const>,
+                                 Ray const&, HitRecord&) const -> bool;
+template auto Bvh::IntersectAnyWide(std::span<WideBvhNode<4> const>,
+                                    Ray const&) const -> bool;
+template void Bvh::Collapse(std::vector<WideBvhNode<8>>&) const;
+template auto Bvh::IntersectWide(std::span<WideBvhNode<8> const>,
+                                 Ray const&, HitRecord&) const -> bool;
+template auto Bvh::IntersectAnyWide(std::span<WideBvhNode<8> const>,
+                                    Ray const&) const -> bool;
+template void Bvh::Collapse(std::vector<CompressedBvhNode<4>>&) const;
+template auto Bvh::IntersectWide(std::span<CompressedBvhNode<4> const>,
+                                 Ray const&, HitRecord&) const -> bool;
+template auto Bvh::IntersectAnyWide(std::span<CompressedBvhNode<4> const>,
+                                    Ray const&) const -> bool;
+template void Bvh::Collapse(std::vector<CompressedBvhNode<8>>&) const;
+template auto Bvh::IntersectWide(std::span<CompressedBvhNode<8> const>,
+                                 Ray const&, HitRecord&) const -> bool;
+template auto Bvh::IntersectAnyWide(std::span<CompressedBvhNode<8> const>,
+                                    Ray const&) const -> bool;
+}  // namespace cherry
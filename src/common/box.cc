@@ -9,10 +9,22 @@
 // Description :
 
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
 
 #include "common/box.h"
 
 namespace cherry {
+namespace {
+// widens the exit distance by 2 * gamma(3) so that rounding in the slab
+// computation never culls a box the ray actually touches
+constexpr double kHalfEpsilon = std::numeric_limits<double>::epsilon() * 0.5;
+constexpr double kSlabRobustness =
+    1 + 2 * (3 * kHalfEpsilon) / (1 - 3 * kHalfEpsilon);
+// each of the six clip planes adds at most one vertex
+constexpr size_t kMaxClipVertices = 16;
+}  // namespace
 
 auto Box::MaxExtent() const -> int {
   auto const kDiagonal = Diagonal();
@@ -41,11 +53,33 @@ auto Box::Intersect(Ray const& ray, Intersection& intersection) const -> bool {
   return kTEnter < kTExit && kTExit > 0;
 }
 
+auto Box::IntersectP(Ray const& ray) const -> bool {
+  auto t0 = ray.t_min;
+  auto t1 = ray.t_max;
+  for (int i = 0; i < 3; ++i) {
+    auto t_near = (min[i] - ray.origin[i]) * ray.direction_inv[i];
+    auto t_far = (max[i] - ray.origin[i]) * ray.direction_inv[i];
+    if (t_near > t_far) std::swap(t_near, t_far);
+    t_far *= kSlabRobustness;
+
+    // written so that a NaN from 0 * inf leaves the interval untouched
+    t0 = t_near > t0 ? t_near : t0;
+    t1 = t_far < t1 ? t_far : t1;
+    if (t0 > t1) return false;
+  }
+  return true;
+}
+
 auto Box::Union(Box const& box) const -> Box {
   auto min = Min(this->min, box.min);
   auto max = Max(this->max, box.max);
   return {min, max};
 }
+auto Box::Clip(Box const& box) const -> Box {
+  auto min = Max(this->min, box.min);
+  auto max = Min(this->max, box.max);
+  return {min, max};
+}
 auto Box::Overlaps(Box const& box) const -> bool {
   auto const kX = (max.x > box.min.x) && (min.x < box.max.x);
   auto const kY = (max.y > box.min.y) && (min.y < box.max.y);
@@ -56,4 +90,43 @@ auto Box::Inside(math::Point3 const& p) const -> bool {
   return p.x > min.x && p.x < max.x && p.y > min.y && p.y < max.y &&
          p.z > min.z && p.z < max.z;
 }
+
+auto ClippedBounds(std::span<math::Point3 const> polygon, Box const& clip)
+    -> Box {
+  // Sutherland-Hodgman against one slab plane at a time
+  std::array<math::Point3, kMaxClipVertices> in{};
+  std::array<math::Point3, kMaxClipVertices> out{};
+  auto count = std::min(polygon.size(), kMaxClipVertices - 6);
+  std::copy_n(polygon.begin(), count, in.begin());
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      auto const kPlane = side == 0 ? clip.min[axis] : clip.max[axis];
+      auto const kInside = [&](math::Point3 const& p) {
+        return side == 0 ? p[axis] >= kPlane : p[axis] <= kPlane;
+      };
+      size_t n = 0;
+      for (size_t i = 0; i < count; ++i) {
+        auto const& a = in[i];
+        auto const& b = in[(i + 1) % count];
+        if (kInside(a)) out[n++] = a;
+        if (kInside(a) != kInside(b)) {
+          auto p = a + (b - a) * ((kPlane - a[axis]) / (b[axis] - a[axis]));
+          p[axis] = kPlane;
+          out[n++] = p;
+        }
+      }
+      count = n;
+      in = out;
+      if (count == 0) {
+        constexpr auto kInf = std::numeric_limits<double>::infinity();
+        return {math::Vector3d(kInf), math::Vector3d(-kInf)};
+      }
+    }
+  }
+
+  Box bounds(in[0]);
+  for (size_t i = 1; i < count; ++i) bounds = bounds.Union(Box(in[i]));
+  // interpolation may overshoot the clip box by an ulp
+  return bounds.Clip(clip);
+}
 }  // namespace cherry
@@ -0,0 +1,22 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : material_table.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 7:10
+// Description : Materials of a scene, referenced by index while rendering
+
+#include "core/material_table.h"
+
+namespace cherry {
+auto MaterialTable::Add(std::shared_ptr<Material> const& material)
+    -> MaterialId {
+  if (material == nullptr) return kNoMaterial;
+  auto const [kIt, kInserted] = ids_.try_emplace(
+      material.get(), static_cast<MaterialId>(materials_.size()));
+  if (kInserted) materials_.push_back(material);
+  return kIt->second;
+}
+}  // namespace cherry
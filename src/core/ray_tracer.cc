@@ -8,7 +8,11 @@
 // Created at  : 2021/08/23 18:47
 // Description :
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <span>
+#include <vector>
 
 #include "fmt/core.h"
 #include "omp.h"
@@ -17,6 +21,15 @@
 
 namespace cherry {
 void RayTracer::Render() {
+  if (integrator_->BatchSize() > 0) {
+    RenderBatches();
+  } else {
+    RenderPackets();
+  }
+  integrator_->ReportStats();
+}
+
+void RayTracer::RenderPackets() {
   auto const& k_camera = scene->camera;
   auto const& k_width = width;
   auto const& k_height = height;
@@ -29,19 +42,56 @@ void RayTracer::Render() {
     auto const kThreadId = omp_get_thread_num();
     auto const kStart = kThreadId * k_height / kThreadCount;
     auto const kEnd = (kThreadId + 1) * k_height / kThreadCount;
+    RayPacket packet;
+    std::array<math::Point3, kPacketSize> radiance;
     for (uint32_t j = kStart; j < kEnd; ++j) {
-      auto m = j * k_width;
-      for (uint32_t i = 0; i < k_width; ++i) {
+      auto const kRow = j * k_width;
+      auto const y = static_cast<double>(j) / static_cast<double>(height - 1);
+      // neighbouring pixels of a row are traced together as one packet
+      for (uint32_t i0 = 0; i0 < k_width; i0 += kPacketSize) {
+        auto const kLanes = std::min<uint32_t>(kPacketSize, k_width - i0);
+        packet.mask = (1U << kLanes) - 1;
         for (int k = 0; k < spp; k++) {
-          auto x = static_cast<double>(i) / static_cast<double>(width - 1);
-          auto y = static_cast<double>(j) / static_cast<double>(height - 1);
-          frame_buffer[m] +=
-              integrator_->Li(k_camera->GenerateRay(x, y), scene) * kSppInv;
+          for (uint32_t lane = 0; lane < kLanes; ++lane) {
+            auto x =
+                static_cast<double>(i0 + lane) / static_cast<double>(width - 1);
+            packet.rays[lane] = k_camera->GenerateRay(x, y);
+          }
+          integrator_->Li(packet, scene, radiance);
+          for (uint32_t lane = 0; lane < kLanes; ++lane)
+            frame_buffer[kRow + i0 + lane] += radiance[lane] * kSppInv;
         }
-        ++m;
       }
     }
   }
 }
 
+void RayTracer::RenderBatches() {
+  auto const& k_camera = scene->camera;
+  auto const kSppInv = 1.0 / static_cast<double>(spp);
+  auto const kBatchSize = integrator_->BatchSize();
+  auto const kSampleCount = width * height * spp;
+  fmt::print("trace with spp: {}, {} paths per batch\n", spp, kBatchSize);
+
+  std::vector<Ray> rays(std::min<uint64_t>(kBatchSize, kSampleCount));
+  std::vector<math::Point3> radiance(rays.size());
+  for (uint64_t first = 0; first < kSampleCount; first += rays.size()) {
+    auto const kCount = std::min<uint64_t>(rays.size(), kSampleCount - first);
+    // the samples of a pixel are adjacent, so are the pixels of a row
+#pragma omp parallel for
+    for (int64_t s = 0; s < static_cast<int64_t>(kCount); ++s) {
+      auto const kPixel = (first + s) / spp;
+      auto x = static_cast<double>(kPixel % width) /
+               static_cast<double>(width - 1);
+      auto y = static_cast<double>(kPixel / width) /
+               static_cast<double>(height - 1);
+      rays[s] = k_camera->GenerateRay(x, y);
+    }
+    integrator_->Li(std::span<Ray const>(rays).first(kCount), scene,
+                    std::span(radiance).first(kCount));
+    for (uint64_t s = 0; s < kCount; ++s)
+      frame_buffer[(first + s) / spp] += radiance[s] * kSppInv;
+  }
+}
+
 }  // namespace cherry
@@ -8,7 +8,9 @@
 // Created at  : 2021/08/23 20:26
 // Description :
 
+#include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "core/scene.h"
 #include "utility/random.h"
@@ -50,6 +52,7 @@ void Scene::SampleLight(Intersection& intersection, double& pdf) const {
 }
 
 void Scene::Add(const std::shared_ptr<Object>& object) {
+  object->BindMaterials(materials_);
   objects_.emplace_back(object);
   if (object->HasEmission()) {
     lights_.emplace_back(object);
@@ -62,6 +65,38 @@ auto Scene::Intersect(Ray const& ray, Intersection& intersection) const
   return bvh_.Intersect(ray, intersection);
 }
 
-void Scene::BuildBvh() { bvh_.Construct(objects_); }
+auto Scene::Occluded(Ray const& ray, double max_distance) const -> bool {
+  auto shadow_ray = ray;
+  shadow_ray.t_max = std::min(shadow_ray.t_max, max_distance);
+  return bvh_.IntersectAny(shadow_ray);
+}
+
+auto Scene::Intersect(RayPacket const& packet,
+                      std::span<Intersection, kPacketSize> intersections) const
+    -> uint32_t {
+  return bvh_.Intersect(packet, intersections);
+}
+
+auto Scene::Occluded(RayPacket const& packet) const -> uint32_t {
+  return bvh_.IntersectAny(packet);
+}
+
+void Scene::BuildBvh(BvhBuildOptions const& options) {
+  if (bvh_object_count_ > 0 && bvh_object_count_ == objects_.size() &&
+      bvh_.Options() == options) {
+    bvh_.Refit(objects_);
+    return;
+  }
+  // a short profiling render: camera rays through random pixels
+  std::vector<Ray> profile_rays;
+  if (options.node_order == BvhNodeOrder::kTreelets) {
+    profile_rays.reserve(options.treelet_profile_rays);
+    for (uint32_t i = 0; i < options.treelet_profile_rays; ++i)
+      profile_rays.push_back(
+          camera->GenerateRay(GetRandomDouble(), GetRandomDouble()));
+  }
+  bvh_.Construct(objects_, options, profile_rays);
+  bvh_object_count_ = objects_.size();
+}
 
 }  // namespace cherry
@@ -1,3 +1,6 @@
+#include <array>
+#include <bit>
+
 #include "integrator/normal_integrator.h"
 
 using namespace cherry::math;
@@ -8,4 +11,17 @@ auto NormalIntegrator::Li(const Ray& ray, const std::shared_ptr<Scene>& scene)
     return intersection.normal.Abs();
   return {};
 }
+
+void NormalIntegrator::Li(RayPacket const& packet,
+                          std::shared_ptr<Scene> const& scene,
+                          std::span<Point3, kPacketSize> radiance) {
+  std::array<Intersection, kPacketSize> intersections;
+  auto const kHit = scene->Intersect(packet, intersections);
+  for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+    auto const kLane = std::countr_zero(lanes);
+    radiance[kLane] = (kHit >> kLane & 1U) != 0
+                          ? intersections[kLane].normal.Abs()
+                          : Point3();
+  }
+}
 }  // namespace cherry
@@ -9,7 +9,10 @@
 // Description :
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <optional>
 
 #include "core/material.h"
 #include "integrator/path_integrator.h"
@@ -18,76 +21,175 @@
 namespace cherry {
 using namespace math;
 
-auto PathIntegrator::Li(Ray const& ray, std::shared_ptr<Scene> const& scene)
-    -> Point3 {
-  Vector3d color(0.0);
-  Vector3d it(1.0);
-  Ray recursive_ray = ray;
-  for (auto depth = 0;; ++depth) {
-    Intersection obj_inter;
-    if (!scene->Intersect(recursive_ray, obj_inter)) break;
+namespace {
+// fraction of the distance to a light sample the shadow ray leaves untested,
+// so that it does not report the sampled light surface itself
+constexpr double kShadowEpsilon = 1e-4;
+
+// a path being traced: the ray leaving its last vertex, the radiance gathered
+// so far and the throughput weighting whatever is gathered next
+struct PathState {
+  Ray ray;
+  Vector3d color{0.0};
+  Vector3d throughput{1.0};
+};
+
+struct LightSample {
+  Intersection point;
+  double pdf = 0.0;
+};
+
+// radiance a light sample adds at a vertex unless shadow_ray is blocked
+// before max_distance
+struct DirectSample {
+  Ray shadow_ray;
+  double max_distance = 0.0;
+  Vector3d radiance;
+};
+
+auto SampleLight(Scene const& scene) -> std::optional<LightSample> {
+  LightSample light;
+  scene.SampleLight(light.point, light.pdf);
+  if (light.pdf <= EPSILON) return std::nullopt;
+  return light;
+}
 
-    // intersect with light
+auto SampleDirect(PathState const& path, Scene const& scene,
+                  Intersection const& hit, LightSample const& light)
+    -> std::optional<DirectSample> {
+  auto const& n = hit.normal;
+  auto const& nn = light.point.normal;
+  auto const& wo = path.ray.direction;
+
+  auto const obj_to_light = light.point.coordinate - hit.coordinate;
+  auto const dist2 = obj_to_light.Norm2();
+  if (dist2 <= EPSILON) return std::nullopt;
+  auto const ws = obj_to_light.Normalized();
+  auto const cos_surface = std::max(0.0, n.Dot(ws));
+  auto const cos_light = std::max(0.0, nn.Dot(-ws));
+  if (cos_surface <= 0.0 || cos_light <= 0.0) return std::nullopt;
+
+  auto const fac = cos_surface * cos_light;
+  return DirectSample{
+      SpawnRay(hit, ws), std::sqrt(dist2) * (1 - kShadowEpsilon),
+      scene.GetMaterial(light.point.material).GetEmission() *
+          path.throughput *
+          scene.GetMaterial(hit.material).Evaluate(wo, ws, n) * fac /
+          (dist2 * light.pdf)};
+}
 
-    if (obj_inter.material->HasEmission()) [[unlikely]]
-      color += obj_inter.material->GetEmission() * it;
+void AddEmission(PathState& path, Scene const& scene, Intersection const& hit) {
+  auto& material = scene.GetMaterial(hit.material);
+  if (material.HasEmission()) [[unlikely]]
+    path.color += material.GetEmission() * path.throughput;
+}
 
-    // direct lighting
+// russian roulette and BSDF sampling of the next ray, false when the path ends
+auto Scatter(PathState& path, Scene const& scene, Intersection const& hit,
+             int depth) -> bool {
+  if (depth > 3) {
+    auto russian_roulette =
+        std::min(std::max(path.throughput.MaxElement(), 0.0), 0.9);
+    if (russian_roulette <= EPSILON) return false;
+    if (auto rr = GetRandomDouble(); rr > russian_roulette) return false;
+    path.throughput /= russian_roulette;
+  }
 
-    if (!scene->GetLights().empty()) {
-      Intersection light_inter;
-      double pdf_emit = 0.0;
-
-      scene->SampleLight(light_inter, pdf_emit);
-      if (pdf_emit > EPSILON) {
-        auto const& n = obj_inter.normal;
-        auto const& nn = light_inter.normal;
-        auto const& wo = recursive_ray.direction;
-
-        auto const obj_to_light = light_inter.coordinate - obj_inter.coordinate;
-        auto const dist2 = obj_to_light.Norm2();
-        if (dist2 > EPSILON) {
-          auto const ws = obj_to_light.Normalized();
-          auto const cos_surface = std::max(0.0, n.Dot(ws));
-          auto const cos_light = std::max(0.0, nn.Dot(-ws));
-          if (cos_surface > 0.0 && cos_light > 0.0) {
-            Ray obj_to_light_ray(obj_inter.coordinate, ws);
-            Intersection occ;
-            if (scene->Intersect(obj_to_light_ray, occ) &&
-                (occ.coordinate - light_inter.coordinate).Norm2() < 1e-4) {
-              auto const fac = cos_surface * cos_light;
-              color += light_inter.material->GetEmission() * it *
-                       obj_inter.material->Evaluate(wo, ws, n) * fac /
-                       (dist2 * pdf_emit);
-            }
-          }
-        }
-      }
-    }
+  auto const& wo = path.ray.direction;
+  auto const& n = hit.normal;
+  auto& material = scene.GetMaterial(hit.material);
+  auto wi = material.Sample(wo, n);
+  if (wi.Norm2() <= EPSILON) return false;
+  wi = wi.Normalized();
+
+  auto const pdf_bsdf = material.Pdf(wo, wi, n);
+  if (pdf_bsdf <= EPSILON) return false;
+
+  auto const f = material.Evaluate(wo, wi, n);
+  path.throughput *= f * std::abs(wi.Dot(n)) / pdf_bsdf;
+
+  path.ray = SpawnRay(hit, wi);
+  return true;
+}
 
-    if (depth > 3) {
-      auto russian_roulette = std::min(std::max(it.MaxElement(), 0.0), 0.9);
-      if (russian_roulette <= EPSILON) break;
-      if (auto rr = GetRandomDouble(); rr > russian_roulette) break;
-      it /= russian_roulette;
+// follows the path from path.ray, the vertex it hits next is at depth
+void Trace(PathState& path, Scene const& scene, int depth) {
+  for (;; ++depth) {
+    Intersection hit;
+    if (!scene.Intersect(path.ray, hit)) break;
+
+    // intersect with light
+    AddEmission(path, scene, hit);
+
+    // direct lighting
+    if (!scene.GetLights().empty()) {
+      if (auto const kLight = SampleLight(scene)) {
+        auto const kDirect = SampleDirect(path, scene, hit, *kLight);
+        if (kDirect &&
+            !scene.Occluded(kDirect->shadow_ray, kDirect->max_distance))
+          path.color += kDirect->radiance;
+      }
     }
 
     // indirect lighting for next iteration
+    if (!Scatter(path, scene, hit, depth)) break;
+  }
+}
+}  // namespace
 
-    auto const& wo = recursive_ray.direction;
-    auto const& n = obj_inter.normal;
-    auto wi = obj_inter.material->Sample(wo, n);
-    if (wi.Norm2() <= EPSILON) break;
-    wi = wi.Normalized();
+auto PathIntegrator::Li(Ray const& ray, std::shared_ptr<Scene> const& scene)
+    -> Point3 {
+  PathState path{ray};
+  Trace(path, *scene, 0);
+  return path.color;
+}
 
-    auto const pdf_bsdf = obj_inter.material->Pdf(wo, wi, n);
-    if (pdf_bsdf <= EPSILON) break;
+void PathIntegrator::Li(RayPacket const& packet,
+                        std::shared_ptr<Scene> const& scene,
+                        std::span<Point3, kPacketSize> radiance) {
+  std::array<Intersection, kPacketSize> hits;
+  auto const kHit = scene->Intersect(packet, hits);
+
+  std::array<PathState, kPacketSize> paths;
+  for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+    auto const kLane = std::countr_zero(lanes);
+    paths[kLane].ray = packet.rays[kLane];
+    if ((kHit >> kLane & 1U) != 0)
+      AddEmission(paths[kLane], *scene, hits[kLane]);
+  }
 
-    auto const f = obj_inter.material->Evaluate(wo, wi, n);
-    it *= f * std::abs(wi.Dot(n)) / pdf_bsdf;
+  // each lane samples its own light point, only the shadow rays are traced
+  // together
+  if (kHit != 0 && !scene->GetLights().empty()) {
+    RayPacket shadow;
+    std::array<Vector3d, kPacketSize> direct;
+    for (auto lanes = kHit; lanes != 0; lanes &= lanes - 1) {
+      auto const kLane = std::countr_zero(lanes);
+      auto const kLight = SampleLight(*scene);
+      if (!kLight) continue;
+      auto const kDirect =
+          SampleDirect(paths[kLane], *scene, hits[kLane], *kLight);
+      if (!kDirect) continue;
+      shadow.rays[kLane] = kDirect->shadow_ray;
+      shadow.rays[kLane].t_max =
+          std::min(shadow.rays[kLane].t_max, kDirect->max_distance);
+      direct[kLane] = kDirect->radiance;
+      shadow.mask |= 1U << kLane;
+    }
+    auto const kBlocked = scene->Occluded(shadow);
+    for (auto lanes = shadow.mask & ~kBlocked; lanes != 0;
+         lanes &= lanes - 1) {
+      auto const kLane = std::countr_zero(lanes);
+      paths[kLane].color += direct[kLane];
+    }
+  }
 
-    recursive_ray = Ray(obj_inter.coordinate, wi);
+  for (auto lanes = packet.mask; lanes != 0; lanes &= lanes - 1) {
+    auto const kLane = std::countr_zero(lanes);
+    if ((kHit >> kLane & 1U) != 0 &&
+        Scatter(paths[kLane], *scene, hits[kLane], 0))
+      Trace(paths[kLane], *scene, 1);
+    radiance[kLane] = paths[kLane].color;
   }
-  return color;
 }
 }  // namespace cherry
@@ -0,0 +1,381 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : wavefront_integrator.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 23:40
+// Description : Path tracer running batches of paths stage by stage
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+#include "omp.h"
+
+#include "core/material.h"
+#include "integrator/wavefront_integrator.h"
+#include "utility/morton.h"
+#include "utility/random.h"
+
+namespace cherry {
+using namespace math;
+
+namespace {
+// fraction of the distance to a light sample the shadow ray leaves untested,
+// so that it does not report the sampled light surface itself
+constexpr double kShadowEpsilon = 1e-4;
+// one per bit of Material::Attribute
+constexpr int kMaterialKinds = 7;
+// rays are binned on a grid of 2^kOriginBits cells per axis of the scene
+// bounds, below the 3 bits of their direction octant
+constexpr int kOriginBits = 7;
+constexpr int kRayKeyBits = 3 + 3 * kOriginBits;
+
+template <typename T>
+using Channels = std::array<std::vector<T>, 3>;
+
+auto Load(Channels<double> const& channels, size_t i) -> Vector3d {
+  return {channels[0][i], channels[1][i], channels[2][i]};
+}
+
+void Store(Channels<double>& channels, size_t i, Vector3d const& value) {
+  for (int axis = 0; axis < 3; ++axis) channels[axis][i] = value[axis];
+}
+
+void Resize(Channels<double>& channels, size_t size) {
+  for (auto& channel : channels) channel.resize(size);
+}
+
+// rays of the live paths, one per path at most
+struct RayQueue {
+  Channels<double> origin;
+  Channels<double> direction;
+  std::vector<uint32_t> path;
+  size_t size = 0;
+
+  void Reserve(size_t capacity) {
+    Resize(origin, capacity);
+    Resize(direction, capacity);
+    path.resize(capacity);
+  }
+
+  // safe to call from several threads, returns the slot of the ray
+  auto Push(Ray const& ray, uint32_t path_index) -> size_t {
+    auto const kSlot =
+        std::atomic_ref(size).fetch_add(1, std::memory_order_relaxed);
+    Store(origin, kSlot, ray.origin);
+    Store(direction, kSlot, ray.direction);
+    path[kSlot] = path_index;
+    return kSlot;
+  }
+
+  [[nodiscard]] auto Get(size_t i) const -> Ray {
+    return {Load(origin, i), Load(direction, i)};
+  }
+};
+
+// closest hits of a ray queue, indexed like it
+struct HitQueue {
+  Channels<double> position;
+  // bound on the error of position, rays leaving it are offset by it
+  Channels<double> error;
+  Channels<double> normal;
+  // nullptr where the ray left the scene
+  std::vector<Material*> material;
+  // indices of the hits grouped by material kind, the shading order
+  std::vector<uint32_t> order;
+  size_t shaded = 0;
+
+  void Reserve(size_t capacity) {
+    Resize(position, capacity);
+    Resize(error, capacity);
+    Resize(normal, capacity);
+    material.resize(capacity);
+    order.resize(capacity);
+  }
+};
+
+// light samples whose radiance reaches their path unless the ray is blocked
+struct ShadowQueue {
+  RayQueue rays;
+  std::vector<double> max_distance;
+  Channels<double> radiance;
+
+  void Reserve(size_t capacity) {
+    rays.Reserve(capacity);
+    max_distance.resize(capacity);
+    Resize(radiance, capacity);
+  }
+};
+
+struct RayKey {
+  uint64_t code;
+  uint32_t index;
+};
+
+/**
+ * @brief Order of the first count rays by direction octant, then by origin
+ * along a Morton curve, so that rays traced one after another tend to visit
+ * the same nodes
+ */
+auto SortRays(RayQueue const& rays, Box const& bounds) -> std::vector<RayKey> {
+  // Box::Offset without a division per ray
+  Vector3d scale;
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const kExtent = bounds.max[axis] - bounds.min[axis];
+    scale[axis] = kExtent > 0 ? 1 / kExtent : 0;
+  }
+  std::vector<RayKey> keys(rays.size);
+#pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(rays.size); ++i) {
+    uint64_t octant = 0;
+    Vector3d offset;
+    for (int axis = 0; axis < 3; ++axis) {
+      octant = octant << 1 | static_cast<uint64_t>(rays.direction[axis][i] < 0);
+      offset[axis] = (rays.origin[axis][i] - bounds.min[axis]) * scale[axis];
+    }
+    keys[i] = {octant << (3 * kOriginBits) | MortonCode(offset, kOriginBits),
+               static_cast<uint32_t>(i)};
+  }
+#pragma omp parallel
+#pragma omp single
+  RadixSort(keys, kRayKeyBits);
+  return keys;
+}
+
+// copies the rays of from into to in the order of keys
+void Gather(RayQueue const& from, std::vector<RayKey> const& keys,
+            RayQueue& to) {
+#pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(keys.size()); ++i) {
+    auto const kFrom = keys[i].index;
+    for (int axis = 0; axis < 3; ++axis) {
+      to.origin[axis][i] = from.origin[axis][kFrom];
+      to.direction[axis][i] = from.direction[axis][kFrom];
+    }
+    to.path[i] = from.path[kFrom];
+  }
+  to.size = keys.size();
+}
+
+void Gather(ShadowQueue const& from, std::vector<RayKey> const& keys,
+            ShadowQueue& to) {
+  Gather(from.rays, keys, to.rays);
+#pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(keys.size()); ++i) {
+    auto const kFrom = keys[i].index;
+    to.max_distance[i] = from.max_distance[kFrom];
+    for (int c = 0; c < 3; ++c) to.radiance[c][i] = from.radiance[c][kFrom];
+  }
+}
+
+struct PathStates {
+  Channels<double> throughput;
+  Channels<double> radiance;
+};
+
+auto MaterialKind(Material const& material) -> int {
+  return std::min(std::countr_zero(static_cast<size_t>(material.attribute)),
+                  kMaterialKinds - 1);
+}
+
+// stage 1: closest hit of every queued ray
+void Extend(Scene const& scene, RayQueue const& rays, HitQueue& hits) {
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int64_t i = 0; i < static_cast<int64_t>(rays.size); ++i) {
+    Intersection intersection;
+    if (!scene.Intersect(rays.Get(i), intersection)) {
+      hits.material[i] = nullptr;
+      continue;
+    }
+    Store(hits.position, i, intersection.coordinate);
+    Store(hits.error, i, intersection.error);
+    Store(hits.normal, i, intersection.normal);
+    hits.material[i] = &scene.GetMaterial(intersection.material);
+  }
+}
+
+// counting sort of the hits by material kind, escaped rays are dropped
+void SortByMaterial(size_t count, HitQueue& hits) {
+  std::array<size_t, kMaterialKinds> offsets{};
+  for (size_t i = 0; i < count; ++i)
+    if (hits.material[i] != nullptr)
+      ++offsets[MaterialKind(*hits.material[i])];
+  size_t offset = 0;
+  for (auto& kind_offset : offsets)
+    offset += std::exchange(kind_offset, offset);
+  hits.shaded = offset;
+  for (size_t i = 0; i < count; ++i)
+    if (hits.material[i] != nullptr)
+      hits.order[offsets[MaterialKind(*hits.material[i])]++] =
+          static_cast<uint32_t>(i);
+}
+
+// stage 2: emission, a light sample for the shadow queue and the next ray
+void Shade(Scene const& scene, int depth, RayQueue const& rays,
+           HitQueue const& hits, PathStates& paths, RayQueue& next,
+           ShadowQueue& shadow) {
+  auto const kHasLights = !scene.GetLights().empty();
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int64_t k = 0; k < static_cast<int64_t>(hits.shaded); ++k) {
+    auto const kHit = hits.order[k];
+    auto const kPath = rays.path[kHit];
+    auto& material = *hits.material[kHit];
+    auto const kPosition = Load(hits.position, kHit);
+    auto const kError = Load(hits.error, kHit);
+    auto const kNormal = Load(hits.normal, kHit);
+    auto const kWo = Load(rays.direction, kHit);
+    auto throughput = Load(paths.throughput, kPath);
+
+    if (material.HasEmission()) [[unlikely]]
+      Store(paths.radiance, kPath,
+            Load(paths.radiance, kPath) + material.GetEmission() * throughput);
+
+    if (kHasLights) {
+      Intersection light;
+      double pdf_light = 0.0;
+      scene.SampleLight(light, pdf_light);
+      auto const kToLight = light.coordinate - kPosition;
+      auto const kDist2 = kToLight.Norm2();
+      if (pdf_light > EPSILON && kDist2 > EPSILON) {
+        auto const ws = kToLight.Normalized();
+        auto const cos_surface = std::max(0.0, kNormal.Dot(ws));
+        auto const cos_light = std::max(0.0, light.normal.Dot(-ws));
+        if (cos_surface > 0.0 && cos_light > 0.0) {
+          auto const kSlot = shadow.rays.Push(
+              Ray(OffsetRayOrigin(kPosition, kError, kNormal, ws), ws), kPath);
+          shadow.max_distance[kSlot] =
+              std::sqrt(kDist2) * (1 - kShadowEpsilon);
+          Store(shadow.radiance, kSlot,
+                scene.GetMaterial(light.material).GetEmission() * throughput *
+                    material.Evaluate(kWo, ws, kNormal) * cos_surface *
+                    cos_light / (kDist2 * pdf_light));
+        }
+      }
+    }
+
+    if (depth > 3) {
+      auto russian_roulette =
+          std::min(std::max(throughput.MaxElement(), 0.0), 0.9);
+      if (russian_roulette <= EPSILON) continue;
+      if (auto rr = GetRandomDouble(); rr > russian_roulette) continue;
+      throughput /= russian_roulette;
+    }
+    auto wi = material.Sample(kWo, kNormal);
+    if (wi.Norm2() <= EPSILON) continue;
+    wi = wi.Normalized();
+    auto const pdf_bsdf = material.Pdf(kWo, wi, kNormal);
+    if (pdf_bsdf <= EPSILON) continue;
+    throughput *= material.Evaluate(kWo, wi, kNormal) *
+                  std::abs(wi.Dot(kNormal)) / pdf_bsdf;
+    Store(paths.throughput, kPath, throughput);
+    next.Push(Ray(OffsetRayOrigin(kPosition, kError, kNormal, wi), wi),
+              kPath);
+  }
+}
+
+// stage 3: add the light samples nothing blocks, a path has one at most
+void Shadow(Scene const& scene, ShadowQueue const& shadow, PathStates& paths) {
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int64_t i = 0; i < static_cast<int64_t>(shadow.rays.size); ++i) {
+    if (scene.Occluded(shadow.rays.Get(i), shadow.max_distance[i])) continue;
+    auto const kPath = shadow.rays.path[i];
+    for (int c = 0; c < 3; ++c)
+      paths.radiance[c][kPath] += shadow.radiance[c][i];
+  }
+}
+}  // namespace
+
+auto WavefrontIntegrator::Li(Ray const& ray,
+                             std::shared_ptr<Scene> const& scene) -> Point3 {
+  Point3 radiance;
+  Li(std::span(&ray, 1), scene, std::span(&radiance, 1));
+  return radiance;
+}
+
+void WavefrontIntegrator::Li(std::span<Ray const> rays,
+                             std::shared_ptr<Scene> const& scene,
+                             std::span<Point3> radiance) {
+  auto const kCount = rays.size();
+  PathStates paths;
+  for (auto& channel : paths.throughput) channel.assign(kCount, 1.0);
+  for (auto& channel : paths.radiance) channel.assign(kCount, 0.0);
+
+  RayQueue current;
+  RayQueue next;
+  HitQueue hits;
+  ShadowQueue shadow;
+  current.Reserve(kCount);
+  next.Reserve(kCount);
+  hits.Reserve(kCount);
+  shadow.Reserve(kCount);
+  // the sorted copies of the queues
+  RayQueue sorted;
+  ShadowQueue sorted_shadow;
+  if (options_.sort_rays) {
+    sorted.Reserve(kCount);
+    sorted_shadow.Reserve(kCount);
+  }
+
+  // generate: the camera rays start one path each
+#pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(kCount); ++i) {
+    Store(current.origin, i, rays[i].origin);
+    Store(current.direction, i, rays[i].direction);
+    current.path[i] = static_cast<uint32_t>(i);
+  }
+  current.size = kCount;
+
+  auto const kBounds = scene->Bounds();
+  for (int depth = 0; current.size > 0; ++depth) {
+    // camera rays are already in pixel order
+    if (options_.sort_rays && depth > 0) {
+      auto const kStart = omp_get_wtime();
+      Gather(current, SortRays(current, kBounds), sorted);
+      std::swap(current, sorted);
+      sort_seconds_ += omp_get_wtime() - kStart;
+    }
+    auto const kExtendStart = omp_get_wtime();
+    Extend(*scene, current, hits);
+    trace_seconds_ += omp_get_wtime() - kExtendStart;
+    extension_rays_ += current.size;
+
+    SortByMaterial(current.size, hits);
+    next.size = 0;
+    shadow.rays.size = 0;
+    Shade(*scene, depth, current, hits, paths, next, shadow);
+
+    if (options_.sort_rays && depth > 0) {
+      auto const kStart = omp_get_wtime();
+      Gather(shadow, SortRays(shadow.rays, kBounds), sorted_shadow);
+      std::swap(shadow, sorted_shadow);
+      sort_seconds_ += omp_get_wtime() - kStart;
+    }
+    auto const kShadowStart = omp_get_wtime();
+    Shadow(*scene, shadow, paths);
+    trace_seconds_ += omp_get_wtime() - kShadowStart;
+    shadow_rays_ += shadow.rays.size;
+    std::swap(current, next);
+  }
+
+  // accumulate
+  for (size_t i = 0; i < kCount; ++i) radiance[i] = Load(paths.radiance, i);
+}
+
+void WavefrontIntegrator::ReportStats() const {
+  auto const kRays = extension_rays_ + shadow_rays_;
+  auto const kSeconds = trace_seconds_ + sort_seconds_;
+  fmt::print(
+      "traced {} rays ({} extension, {} shadow) in {:.3f} s, sorting {:.3f} "
+      "s: {:.2f} Mrays/s\n",
+      kRays, extension_rays_, shadow_rays_, trace_seconds_, sort_seconds_,
+      kSeconds > 0.0 ? static_cast<double>(kRays) / kSeconds * 1e-6 : 0.0);
+}
+}  // namespace cherry
@@ -2,6 +2,10 @@
 #include "utility/random.h"
 
 namespace cherry {
+void DirectionalLight::Translate(math::Vector3d const& offset) {
+  shoot_from_ += offset;
+}
+
 void DirectionalLight::Sample(Intersection& intersection, double& p) {
   auto const kX = 1 - GetRandomDouble() * 2;
   auto const kY = 1 - GetRandomDouble() * 2;
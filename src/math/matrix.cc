@@ -13,26 +13,6 @@
 
 namespace cherry::math {
 
-template <Number T>
-auto Matrix4<T>::operator=(Matrix4<T> const& m) noexcept -> Matrix4<T>& {
-  if (this != &m) {
-    this->last_index = m.last_index;
-    std::copy(m.value_, m.value_ + 16, value_);
-  }
-  return *this;
-}
-
-template <Number T>
-auto Matrix4<T>::operator=(Matrix4<T>&& m) noexcept -> Matrix4<T>& {
-  if (this != &m) {
-    this->last_index_ = m.last_index_;
-    std::copy(m.value_.begin(), m.value_.end(), value_.begin());
-
-    m.last_index_ = 0;
-  }
-  return *this;
-}
-
 template <Number T>
 auto Matrix4<T>::operator+(Matrix4<T> const& m) const -> Matrix4<T> {
   auto result = Matrix4<T>();
@@ -112,7 +92,7 @@ auto Matrix4<T>::ElementWiseProduct(Matrix4<T> const& m) -> Matrix4<T> {
 }
 
 template <Number T>
-auto GluInvertMatrix(std::array<T, 16> const m, std::array<T, 16> inv_out)
+auto GluInvertMatrix(std::array<T, 16> const& m, std::array<T, 16>& inv_out)
     -> bool {
   std::array<T, 16> inv{0};
   T det;
@@ -198,6 +178,8 @@ template <Number T>
 const Matrix4<T> Matrix4<T>::IDENTITY(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0,
                                       0, 1);
 
+template struct Matrix4<double>;
+
 auto GetRotateMatrix(Vector3d const& axis, double const& rad) -> Matrix {
   Matrix const kN{0,        -axis(2), axis(1), 0, axis(2), 0, -axis(0), 0,
                   -axis(1), axis(0),  0,       0, 0,       0, 0,        0};
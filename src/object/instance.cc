@@ -0,0 +1,119 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : instance.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 18:05
+// Description :
+
+#include "object/instance.h"
+
+#include <utility>
+
+namespace cherry {
+namespace {
+auto TransformPoint(math::Matrix const& m, math::Point3 const& p)
+    -> math::Point3 {
+  auto v = m * p.AsPoint();
+  v.Regularize();
+  return {v.x, v.y, v.z};
+}
+
+// bound on the error of TransformPoint(m, p) for a point p known up to error
+auto TransformError(math::Matrix const& m, math::Point3 const& p,
+                    math::Vector3d const& error) -> math::Vector3d {
+  math::Vector3d result;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      auto const kM = std::abs(m(i + 1, j + 1));
+      result[i] += kM * ((1 + Gamma(3)) * error[j] + Gamma(3) * std::abs(p[j]));
+    }
+    result[i] += Gamma(3) * std::abs(m(i + 1, 4));
+  }
+  return result;
+}
+
+auto TransformVector(math::Matrix const& m, math::Vector3d const& d)
+    -> math::Vector3d {
+  auto const kV = m * d.AsVector();
+  return {kV.x, kV.y, kV.z};
+}
+
+// normals go through the inverse transpose, i.e. the transposed
+// world_to_object matrix
+auto TransformNormal(math::Matrix const& world_to_object,
+                     math::Vector3d const& n) -> math::Vector3d {
+  math::Vector3d result;
+  for (int i = 0; i < 3; ++i)
+    result[i] = world_to_object(1, i + 1) * n[0] +
+                world_to_object(2, i + 1) * n[1] +
+                world_to_object(3, i + 1) * n[2];
+  return result.Normalized();
+}
+}  // namespace
+
+Instance::Instance(std::shared_ptr<Bvh> blas,
+                   math::Matrix const& object_to_world)
+    : blas_(std::move(blas)),
+      object_to_world_(object_to_world),
+      world_to_object_(object_to_world.Inverse()) {
+  auto const kLocal = blas_->Bounds();
+  bounds_ = Box(TransformPoint(object_to_world_, kLocal.min));
+  for (int i = 1; i < 8; ++i) {
+    math::Point3 const kCorner{i & 1 ? kLocal.max.x : kLocal.min.x,
+                               i & 2 ? kLocal.max.y : kLocal.min.y,
+                               i & 4 ? kLocal.max.z : kLocal.min.z};
+    bounds_ = bounds_.Union(Box(TransformPoint(object_to_world_, kCorner)));
+  }
+}
+
+auto Instance::ToObject(Ray const& ray) const -> Ray {
+  Ray local(TransformPoint(world_to_object_, ray.origin),
+            TransformVector(world_to_object_, ray.direction));
+  local.t_min = ray.t_min;
+  local.t_max = ray.t_max;
+  return local;
+}
+
+auto Instance::Intersect(Ray const& ray, HitRecord& record) const -> bool {
+  if (!blas_->Intersect(ToObject(ray), record)) return false;
+  record.instance = this;
+  return true;
+}
+
+void Instance::ComputeIntersection(Ray const& ray, HitRecord const& record,
+                                   Intersection& intersection) const {
+  record.object->ComputeIntersection(ToObject(ray), record, intersection);
+  intersection.error = TransformError(object_to_world_, intersection.coordinate,
+                                      intersection.error);
+  intersection.coordinate =
+      TransformPoint(object_to_world_, intersection.coordinate);
+  intersection.normal = TransformNormal(world_to_object_, intersection.normal);
+}
+
+auto Instance::IntersectP(Ray const& ray) const -> bool {
+  return blas_->IntersectAny(ToObject(ray));
+}
+
+auto Instance::GetBounds() -> Box { return bounds_; }
+
+void Instance::Translate(math::Vector3d const& offset) {
+  object_to_world_ = math::GetTransformMatrix(offset) * object_to_world_;
+  world_to_object_ = object_to_world_.Inverse();
+  bounds_ = {bounds_.min + offset, bounds_.max + offset};
+}
+
+void Instance::BindMaterials(MaterialTable& materials) {
+  blas_->BindMaterials(materials);
+}
+
+void Instance::Sample(Intersection& /*intersection*/, double& pdf) {
+  pdf = 0.0;
+}
+
+auto Instance::HasEmission() const -> bool { return false; }
+
+auto Instance::GetSurfaceArea() const -> double { return 0.0; }
+}  // namespace cherry
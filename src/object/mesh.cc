@@ -6,16 +6,327 @@
 // File Name   : mesh.cc
 // Author      : QRWells
 // Created at  : 2021/08/31 23:52
-// Description :
+// Description : Indexed triangle mesh with its own BVH
 
 #include "object/mesh.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <utility>
+
+#include "core/material.h"
+#include "utility/constant.h"
+#include "utility/random.h"
+
 namespace cherry {
+namespace {
+auto Flatten(BvhBuildNode const& node, std::vector<LinearBvhNode>& nodes)
+    -> uint32_t {
+  auto const kIndex = static_cast<uint32_t>(nodes.size());
+  nodes.emplace_back();
+  nodes[kIndex].bounds = node.bounds;
+  nodes[kIndex].axis = node.axis;
+  if (node.children[0] == nullptr) {
+    nodes[kIndex].primitives_offset = node.first_primitive;
+    nodes[kIndex].primitive_count =
+        static_cast<uint16_t>(node.primitive_count);
+  } else {
+    nodes[kIndex].primitive_count = 0;
+    auto const kFirst = Flatten(*node.children[0], nodes);
+    auto const kSecond = Flatten(*node.children[1], nodes);
+    nodes[kIndex].first_child_offset = kFirst;
+    nodes[kIndex].second_child_offset = kSecond;
+  }
+  return kIndex;
+}
+}  // namespace
+
+Mesh::Mesh(std::shared_ptr<Material> material)
+    : material_(std::move(material)) {}
+
+auto Mesh::Load(std::string const& path) -> bool {
+  auto const kExtension = std::filesystem::path(path).extension();
+  if (kExtension == ".cmesh") return LoadBinary(path);
+  if (kExtension == ".ply") return LoadPly(path);
+  return LoadObj(path);
+}
+
+auto Mesh::LoadObj(std::string const& path) -> bool {
+  MeshData data;
+  if (!ReadObj(path, data)) return false;
+  SetGeometry(std::move(data));
+  return true;
+}
+
+auto Mesh::LoadPly(std::string const& path) -> bool {
+  MeshData data;
+  if (!ReadPly(path, data)) return false;
+  SetGeometry(std::move(data));
+  return true;
+}
+
+void Mesh::SetGeometry(MeshData data) {
+  mapping_.reset();
+  data_ = std::move(data);
+  data_.vertex_index.resize(data_.vertex_index.size() / 3 * 3);
+  packed_normal_data_.clear();
+  Build();
+}
+
+void Mesh::SetGeometry(std::vector<math::Point3> positions,
+                       std::vector<uint32_t> vertex_index,
+                       std::vector<math::Vector3d> normals,
+                       std::vector<math::Point2> uvs) {
+  SetGeometry(MeshData{.positions = std::move(positions),
+                       .normals = std::move(normals),
+                       .uvs = std::move(uvs),
+                       .vertex_index = std::move(vertex_index)});
+}
+
+void Mesh::Bind() {
+  positions_ = data_.positions;
+  normals_ = data_.normals;
+  packed_normals_ = packed_normal_data_;
+  uvs_ = data_.uvs;
+  vertex_index_ = data_.vertex_index;
+  nodes_ = node_data_;
+  blocks_ = block_data_;
+  area_cdf_ = area_cdf_data_;
+}
+
+void Mesh::Detach() {
+  if (!mapping_) return;
+  data_.positions.assign(positions_.begin(), positions_.end());
+  data_.normals.assign(normals_.begin(), normals_.end());
+  packed_normal_data_.assign(packed_normals_.begin(), packed_normals_.end());
+  data_.uvs.assign(uvs_.begin(), uvs_.end());
+  data_.vertex_index.assign(vertex_index_.begin(), vertex_index_.end());
+  node_data_.assign(nodes_.begin(), nodes_.end());
+  block_data_.assign(blocks_.begin(), blocks_.end());
+  area_cdf_data_.assign(area_cdf_.begin(), area_cdf_.end());
+  mapping_.reset();
+  Bind();
+}
+
+void Mesh::Build() {
+  node_data_.clear();
+  block_data_.clear();
+  area_cdf_data_.clear();
+  Bind();
+  auto const kCount = static_cast<int64_t>(TriangleCount());
+  if (kCount == 0) return;
+
+  std::vector<BvhPrimitive> references(kCount);
+#pragma omp parallel for
+  for (int64_t i = 0; i < kCount; ++i) {
+    auto const kTriangle = static_cast<uint32_t>(i);
+    auto& reference = references[i];
+    reference.bounds = Box(Vertex(kTriangle, 0))
+                           .Union(Box(Vertex(kTriangle, 1)))
+                           .Union(Box(Vertex(kTriangle, 2)));
+    reference.centroid = reference.bounds.Centroid();
+    reference.index = kTriangle;
+  }
+  // binned SAH without spatial splits, so every triangle is referenced by
+  // exactly one leaf and can be moved into its range
+  BvhBuildOptions options;
+  options.quality = BvhBuildQuality::kFast;
+  options.max_leaf_size = kTriangleBlockWidth;
+  options.leaf_batch_size = kTriangleBlockWidth;
+  BvhBuilder builder(std::move(references), options);
+  auto const kRoot = builder.Build();
+
+  std::vector<uint32_t> vertex_index(data_.vertex_index.size());
+  auto const& order = builder.Primitives();
+  for (size_t i = 0; i < order.size(); ++i) {
+    std::copy_n(data_.vertex_index.begin() + 3 * order[i].index, 3,
+                vertex_index.begin() + 3 * i);
+  }
+  data_.vertex_index.swap(vertex_index);
+  node_data_.reserve(builder.NodeCount());
+  Flatten(*kRoot, node_data_);
+  BuildBlocks();
+
+  area_cdf_data_.resize(kCount);
+  double area = 0.0;
+  for (uint32_t i = 0; i < kCount; ++i) {
+    auto const& v0 = Vertex(i, 0);
+    area += 0.5 * (Vertex(i, 1) - v0).Cross(Vertex(i, 2) - v0).Norm();
+    area_cdf_data_[i] = area;
+  }
+  Bind();
+}
+
+void Mesh::BuildBlocks() {
+  std::vector<uint32_t> leaves;
+  for (uint32_t i = 0; i < node_data_.size(); ++i) {
+    if (node_data_[i].primitive_count == 0) continue;
+    node_data_[i].first_child_offset = static_cast<uint32_t>(leaves.size());
+    leaves.push_back(i);
+  }
+  block_data_.resize(leaves.size());
+  Bind();
+  auto const kLeafCount = static_cast<int64_t>(leaves.size());
+#pragma omp parallel for
+  for (int64_t i = 0; i < kLeafCount; ++i) {
+    auto const& leaf = node_data_[leaves[i]];
+    std::array<std::array<math::Point3, 3>, kTriangleBlockWidth> triangles;
+    for (uint32_t j = 0; j < leaf.primitive_count; ++j) {
+      for (int corner = 0; corner < 3; ++corner)
+        triangles[j][corner] = Vertex(leaf.primitives_offset + j, corner);
+    }
+    block_data_[i] = MakeTriangleBlock<kTriangleBlockWidth>(
+        std::span(triangles).first(leaf.primitive_count));
+  }
+}
+
+auto Mesh::HitTriangle(uint32_t triangle, Ray const& ray, double& t,
+                       double& b1, double& b2) const -> bool {
+  auto const& v0 = Vertex(triangle, 0);
+  auto const kE1 = Vertex(triangle, 1) - v0;
+  auto const kE2 = Vertex(triangle, 2) - v0;
+  auto const kPVec = ray.direction.Cross(kE2);
+  // the determinant is the cosine against the unnormalized face normal with
+  // the sign flipped: back faces and rays in the plane give kDet <= 0
+  auto const kDet = kE1.Dot(kPVec);
+  if (!(kDet > 0)) return false;
+
+  auto const kDetInv = 1.0 / kDet;
+  auto const kTVec = ray.origin - v0;
+  b1 = kTVec.Dot(kPVec) * kDetInv;
+  if (b1 < 0 || b1 > 1) return false;
+  auto const kQVec = kTVec.Cross(kE1);
+  b2 = ray.direction.Dot(kQVec) * kDetInv;
+  if (b2 < 0 || b1 + b2 > 1) return false;
+  t = kE2.Dot(kQVec) * kDetInv;
+  return t >= ray.t_min && t <= ray.t_max;
+}
+
+auto Mesh::Traverse(Ray const& ray, bool any_hit, uint32_t& triangle,
+                    double& t, double& b1, double& b2) const -> bool {
+  if (nodes_.empty()) return false;
+  Ray closest = ray;
+  auto const kBlockRay = MakeTriangleBlockRay(ray);
+  bool hit = false;
+  auto const kVisitLeaf = [&](LinearBvhNode const& node) {
+    // the block rules out most triangles at once, the rest are confirmed in
+    // double precision
+    auto candidates =
+        TriangleBlockCandidates(blocks_[node.first_child_offset], kBlockRay,
+                                closest.t_max, node.primitive_count);
+    for (; candidates != 0; candidates &= candidates - 1) {
+      auto const i = node.primitives_offset +
+                     static_cast<uint32_t>(std::countr_zero(candidates));
+      double t_hit = 0;
+      double u = 0;
+      double v = 0;
+      if (!HitTriangle(i, closest, t_hit, u, v)) continue;
+      triangle = i;
+      t = t_hit;
+      b1 = u;
+      b2 = v;
+      if (any_hit) return true;
+      closest.t_max = t_hit;
+      hit = true;
+    }
+    return false;
+  };
+  return TraverseBinary(nodes_, 0, closest, true, kVisitLeaf) || hit;
+}
+
+auto Mesh::Intersect(Ray const& ray, HitRecord& record) const -> bool {
+  uint32_t triangle = 0;
+  double t = 0;
+  double b1 = 0;
+  double b2 = 0;
+  if (!Traverse(ray, false, triangle, t, b1, b2)) return false;
+  record = {.distance = t,
+            .object = this,
+            .primitive = triangle,
+            .b1 = b1,
+            .b2 = b2};
+  return true;
+}
+
+void Mesh::ComputeIntersection(Ray const& /*ray*/, HitRecord const& record,
+                               Intersection& intersection) const {
+  auto const kB1 = record.b1;
+  auto const kB2 = record.b2;
+  auto const kB0 = 1.0 - kB1 - kB2;
+  auto const* kIndex = &vertex_index_[3 * record.primitive];
+  // interpolated from the vertices like Triangle
+  auto const kP0 = Vertex(record.primitive, 0) * kB0;
+  auto const kP1 = Vertex(record.primitive, 1) * kB1;
+  auto const kP2 = Vertex(record.primitive, 2) * kB2;
+  intersection.coordinate = kP0 + kP1 + kP2;
+  intersection.error = (kP0.Abs() + kP1.Abs() + kP2.Abs()) * Gamma(7);
+  intersection.distance = record.distance;
+  intersection.material = material_id_;
+  if (normals_.empty() && packed_normals_.empty()) {
+    auto const& v0 = positions_[kIndex[0]];
+    intersection.normal =
+        (positions_[kIndex[1]] - v0).Cross(positions_[kIndex[2]] - v0);
+  } else {
+    intersection.normal = Normal(kIndex[0]) * kB0 + Normal(kIndex[1]) * kB1 +
+                          Normal(kIndex[2]) * kB2;
+  }
+  intersection.normal = intersection.normal.Normalized();
+  if (!uvs_.empty())
+    intersection.uv = uvs_[kIndex[0]] * kB0 + uvs_[kIndex[1]] * kB1 +
+                      uvs_[kIndex[2]] * kB2;
+}
+
+auto Mesh::IntersectP(Ray const& ray) const -> bool {
+  uint32_t triangle = 0;
+  double t = 0;
+  double b1 = 0;
+  double b2 = 0;
+  return Traverse(ray, true, triangle, t, b1, b2);
+}
+
+auto Mesh::GetBounds() -> Box {
+  return nodes_.empty() ? Box() : nodes_[0].bounds;
+}
+
+void Mesh::Translate(math::Vector3d const& offset) {
+  Detach();
+  for (auto& position : data_.positions) position += offset;
+  for (auto& node : node_data_)
+    node.bounds = {node.bounds.min + offset, node.bounds.max + offset};
+  BuildBlocks();
+}
+
+void Mesh::BindMaterials(MaterialTable& materials) {
+  material_id_ = materials.Add(material_);
+}
+
+void Mesh::Sample(Intersection& intersection, double& pdf) {
+  pdf = 0.0;
+  if (area_cdf_.empty() || !(area_cdf_.back() > 0)) return;
+
+  auto const kTarget = GetRandomDouble() * area_cdf_.back();
+  auto const kTriangle = static_cast<uint32_t>(std::min<size_t>(
+      std::ranges::upper_bound(area_cdf_, kTarget) - area_cdf_.begin(),
+      area_cdf_.size() - 1));
+  auto const& v0 = Vertex(kTriangle, 0);
+  auto const& v1 = Vertex(kTriangle, 1);
+  auto const& v2 = Vertex(kTriangle, 2);
+  auto const kX = std::sqrt(GetRandomDouble());
+  auto const kY = GetRandomDouble();
+  intersection.coordinate =
+      v0 * (1.0 - kX) + v1 * (kX * (1.0 - kY)) + v2 * (kX * kY);
+  intersection.normal = (v1 - v0).Cross(v2 - v0).Normalized();
+  intersection.material = material_id_;
+  pdf = 1.0 / area_cdf_.back();
+}
+
+auto Mesh::HasEmission() const -> bool {
+  return material_ != nullptr && material_->GetEmission().Norm2() > EPSILON;
+}
 
-void Mesh::LoadObj(std::string const&) {}
-auto Mesh::GetBounds() -> Box { return bounding_box; }
-auto Mesh::Intersect(Ray const&, Intersection&) const -> bool { return false; }
-void Mesh::Sample(Intersection&, double&) {}
-auto Mesh::HasEmission() const -> bool { return false; }
-auto Mesh::GetSurfaceArea() const -> double { return 0.0; }
+auto Mesh::GetSurfaceArea() const -> double {
+  return area_cdf_.empty() ? 0.0 : area_cdf_.back();
+}
 }  // namespace cherry
@@ -0,0 +1,263 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : mesh_binary.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 3:10
+// Description : Cherry mesh files, mapped without copying
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include "fmt/core.h"
+#include "object/mesh.h"
+
+namespace cherry {
+namespace {
+constexpr std::array<char, 8> kMeshMagic = {'C', 'H', 'R', 'Y',
+                                            'M', 'E', 'S', 'H'};
+// bump whenever the file layout or the meaning of a field changes
+constexpr uint32_t kMeshVersion = 2;
+// every array starts on a cache line, which also aligns it for its type
+constexpr size_t kMeshAlignment = 64;
+
+enum class MeshNormals : uint8_t { kNone, kFull, kPacked };
+
+/**
+ * @brief Start of a mesh file. The header is padded to kMeshAlignment and
+ * followed by the arrays of MeshSection in order, each padded to
+ * kMeshAlignment. Files are native-endian.
+ */
+struct MeshHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  // rejects files written by a build with a different node layout
+  uint32_t node_size;
+  uint64_t vertex_count;
+  uint64_t triangle_count;
+  uint64_t node_count;
+  uint64_t block_count;
+  // and by one with a different block width
+  uint32_t block_size;
+  MeshNormals normals;
+  uint8_t has_uvs;
+};
+static_assert(sizeof(MeshHeader) <= kMeshAlignment);
+
+enum MeshSection {
+  kNodes,
+  kBlocks,
+  kPositions,
+  kNormals,
+  kUvs,
+  kVertexIndex,
+  kAreaCdf,
+  kSectionCount
+};
+
+struct SectionRange {
+  size_t offset;
+  size_t size;
+};
+
+auto AlignUp(size_t size) -> size_t {
+  return (size + kMeshAlignment - 1) / kMeshAlignment * kMeshAlignment;
+}
+
+// where the arrays are, given the counts of the header
+auto Sections(MeshHeader const& header)
+    -> std::array<SectionRange, kSectionCount> {
+  size_t normal_size = 0;
+  if (header.normals == MeshNormals::kFull)
+    normal_size = sizeof(math::Vector3d);
+  if (header.normals == MeshNormals::kPacked) normal_size = sizeof(uint32_t);
+  std::array<size_t, kSectionCount> const kSizes = {
+      header.node_count * sizeof(LinearBvhNode),
+      header.block_count * header.block_size,
+      header.vertex_count * sizeof(math::Point3),
+      header.vertex_count * normal_size,
+      header.has_uvs != 0 ? header.vertex_count * sizeof(math::Point2) : 0,
+      3 * header.triangle_count * sizeof(uint32_t),
+      header.triangle_count * sizeof(double),
+  };
+  std::array<SectionRange, kSectionCount> sections{};
+  size_t offset = kMeshAlignment;
+  for (int i = 0; i < kSectionCount; ++i) {
+    sections[i] = {offset, kSizes[i]};
+    offset = AlignUp(offset + kSizes[i]);
+  }
+  return sections;
+}
+
+template <typename T>
+auto MappedArray(std::span<std::byte const> bytes, SectionRange const& range)
+    -> std::span<T const> {
+  return {reinterpret_cast<T const*>(bytes.data() + range.offset),
+          range.size / sizeof(T)};
+}
+
+// whether the mapped arrays only refer into each other: vertex indices below
+// the vertex count, leaves within the triangles and blocks, children after
+// their parent and no path deeper than the traversal stack
+auto ValidIndices(MeshHeader const& header,
+                  std::span<LinearBvhNode const> nodes,
+                  std::span<uint32_t const> vertex_index) -> bool {
+  for (auto const kIndex : vertex_index)
+    if (kIndex >= header.vertex_count) return false;
+  std::vector<int> depth(nodes.size(), 0);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto const& node = nodes[i];
+    if (depth[i] > kMaxBvhDepth) return false;
+    if (node.primitive_count > 0) {
+      if (node.primitive_count > kTriangleBlockWidth ||
+          node.primitives_offset + uint64_t{node.primitive_count} >
+              header.triangle_count ||
+          node.first_child_offset >= header.block_count)
+        return false;
+      continue;
+    }
+    for (uint64_t const kChild :
+         {node.first_child_offset, node.second_child_offset}) {
+      if (kChild <= i || kChild >= nodes.size()) return false;
+      depth[kChild] = std::max(depth[kChild], depth[i] + 1);
+    }
+  }
+  return true;
+}
+
+template <typename T>
+auto AsBytes(std::span<T const> values) -> std::span<char const> {
+  return {reinterpret_cast<char const*>(values.data()), values.size_bytes()};
+}
+}  // namespace
+
+auto Mesh::LoadBinary(std::string const& path) -> bool {
+  auto mapping = std::make_shared<MappedFile const>(path);
+  auto const kBytes = mapping->Bytes();
+  if (kBytes.size() < kMeshAlignment) return false;
+
+  MeshHeader header{};
+  std::memcpy(&header, kBytes.data(), sizeof(header));
+  if (header.magic != kMeshMagic || header.version != kMeshVersion ||
+      header.node_size != sizeof(LinearBvhNode) ||
+      header.block_size != sizeof(TriangleBlock<kTriangleBlockWidth>) ||
+      header.normals > MeshNormals::kPacked || header.triangle_count == 0 ||
+      header.node_count == 0 || header.block_count == 0 ||
+      header.vertex_count > UINT32_MAX)
+    return false;
+  auto const kSections = Sections(header);
+  auto const& last = kSections[kSectionCount - 1];
+  if (kBytes.size() != AlignUp(last.offset + last.size)) return false;
+  auto const kMappedNodes =
+      MappedArray<LinearBvhNode>(kBytes, kSections[kNodes]);
+  auto const kMappedIndex =
+      MappedArray<uint32_t>(kBytes, kSections[kVertexIndex]);
+  if (!ValidIndices(header, kMappedNodes, kMappedIndex)) return false;
+
+  data_ = {};
+  packed_normal_data_.clear();
+  node_data_.clear();
+  block_data_.clear();
+  area_cdf_data_.clear();
+  nodes_ = kMappedNodes;
+  blocks_ = MappedArray<TriangleBlock<kTriangleBlockWidth>>(
+      kBytes, kSections[kBlocks]);
+  positions_ = MappedArray<math::Point3>(kBytes, kSections[kPositions]);
+  normals_ = {};
+  packed_normals_ = {};
+  if (header.normals == MeshNormals::kFull)
+    normals_ = MappedArray<math::Vector3d>(kBytes, kSections[kNormals]);
+  if (header.normals == MeshNormals::kPacked)
+    packed_normals_ = MappedArray<uint32_t>(kBytes, kSections[kNormals]);
+  uvs_ = MappedArray<math::Point2>(kBytes, kSections[kUvs]);
+  vertex_index_ = kMappedIndex;
+  area_cdf_ = MappedArray<double>(kBytes, kSections[kAreaCdf]);
+  mapping_ = std::move(mapping);
+  return true;
+}
+
+auto Mesh::SaveBinary(std::string const& path, bool pack_normals) const
+    -> bool {
+  MeshHeader header{};
+  header.magic = kMeshMagic;
+  header.version = kMeshVersion;
+  header.node_size = sizeof(LinearBvhNode);
+  header.vertex_count = positions_.size();
+  header.triangle_count = TriangleCount();
+  header.node_count = nodes_.size();
+  header.block_count = blocks_.size();
+  header.block_size = sizeof(TriangleBlock<kTriangleBlockWidth>);
+  header.has_uvs = uvs_.empty() ? 0 : 1;
+
+  // normals are written in the requested form whatever form they are in
+  std::vector<uint32_t> packed;
+  std::vector<math::Vector3d> unpacked;
+  std::span<char const> normal_bytes;
+  if (!normals_.empty() || !packed_normals_.empty()) {
+    if (pack_normals) {
+      header.normals = MeshNormals::kPacked;
+      if (packed_normals_.empty()) {
+        packed.resize(normals_.size());
+        for (size_t i = 0; i < packed.size(); ++i)
+          packed[i] = PackNormal(normals_[i]);
+      }
+      normal_bytes = AsBytes(packed_normals_.empty()
+                                 ? std::span<uint32_t const>(packed)
+                                 : packed_normals_);
+    } else {
+      header.normals = MeshNormals::kFull;
+      if (normals_.empty()) {
+        unpacked.resize(packed_normals_.size());
+        for (size_t i = 0; i < unpacked.size(); ++i)
+          unpacked[i] = UnpackNormal(packed_normals_[i]);
+      }
+      normal_bytes = AsBytes(normals_.empty()
+                                 ? std::span<math::Vector3d const>(unpacked)
+                                 : normals_);
+    }
+  }
+  std::array<std::span<char const>, kSectionCount> const kArrays = {
+      AsBytes(nodes_),        AsBytes(blocks_),       AsBytes(positions_),
+      normal_bytes,           AsBytes(uvs_),          AsBytes(vertex_index_),
+      AsBytes(area_cdf_),
+  };
+  auto const kSections = Sections(header);
+
+  // written beside the target and renamed over it like the BVH cache, so
+  // renders that mapped the old file keep reading it
+  std::filesystem::path const kTarget(path);
+  auto temp = kTarget;
+  temp += fmt::format(".{:08x}.tmp", std::random_device{}());
+  std::error_code error;
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    std::array<char, kMeshAlignment> padding{};
+    std::memcpy(padding.data(), &header, sizeof(header));
+    out.write(padding.data(), padding.size());
+    padding.fill(0);
+    for (int i = 0; i < kSectionCount; ++i) {
+      auto const kBytes = kArrays[i];
+      out.write(kBytes.data(), static_cast<std::streamsize>(kBytes.size()));
+      auto const kEnd = kSections[i].offset + kSections[i].size;
+      out.write(padding.data(),
+                static_cast<std::streamsize>(AlignUp(kEnd) - kEnd));
+    }
+    if (!out) error = std::make_error_code(std::errc::io_error);
+  }
+  if (!error) std::filesystem::rename(temp, kTarget, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+    return false;
+  }
+  return true;
+}
+}  // namespace cherry
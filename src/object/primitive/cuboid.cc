@@ -14,10 +14,7 @@
 #include "utility/random.h"
 
 namespace cherry {
-auto Cuboid::Intersect(Ray const& ray, Intersection& intersection) const
-    -> bool {
-  Intersection result;
-
+auto Cuboid::HitDistance(Ray const& ray, double& t) const -> bool {
   auto const kTMin = (min_ - ray.origin) * ray.direction_inv;
   auto const kTMax = (max_ - ray.origin) * ray.direction_inv;
 
@@ -29,28 +26,56 @@ auto Cuboid::Intersect(Ray const& ray, Intersection& intersection) const
   if (auto const kTExit = std::min({t1.x, t1.y, t1.z});
       (kTEnter >= kTExit) || kTExit < 0)
     return false;
-  if (kTEnter < 0.5) return false;
-
-  result.coordinate = ray(kTEnter);
-  result.material = this->material_;
-  result.distance = kTEnter;
+  if (kTEnter < ray.t_min || kTEnter > ray.t_max) return false;
+  t = kTEnter;
+  return true;
+}
+auto Cuboid::Intersect(Ray const& ray, HitRecord& record) const -> bool {
+  double t_enter = 0;
+  if (!HitDistance(ray, t_enter)) return false;
+  record = {.distance = t_enter, .object = this};
+  return true;
+}
+void Cuboid::ComputeIntersection(Ray const& ray, HitRecord const& record,
+                                 Intersection& intersection) const {
+  Intersection result;
+  result.coordinate = ray(record.distance);
+  result.error =
+      (ray.origin.Abs() + (ray.direction * record.distance).Abs()) * Gamma(3);
+  result.material = material_id_;
+  result.distance = record.distance;
 
-  if (fabs(result.coordinate.x - min_.x) < 1e-2)
-    result.normal = {-1, 0, 0};
-  else if (fabs(result.coordinate.x - max_.x) < 1e-2)
-    result.normal = {1, 0, 0};
-  else if (fabs(result.coordinate.y - min_.y) < 1e-2)
-    result.normal = {0, -1, 0};
-  else if (fabs(result.coordinate.y - max_.y) < 1e-2)
-    result.normal = {0, 1, 0};
-  else if (fabs(result.coordinate.z - min_.z) < 1e-2)
-    result.normal = {0, 0, -1};
-  else if (fabs(result.coordinate.z - max_.z) < 1e-2)
-    result.normal = {0, 0, 1};
+  // the face nearest to the hit, whose plane the hit is snapped onto
+  auto nearest = INFINITY;
+  int axis = 0;
+  double side = -1;
+  for (int i = 0; i < 3; ++i) {
+    for (auto const kSide : {-1.0, 1.0}) {
+      auto const kPlane = kSide < 0 ? min_[i] : max_[i];
+      if (auto const kDistance = std::abs(result.coordinate[i] - kPlane);
+          kDistance < nearest) {
+        nearest = kDistance;
+        axis = i;
+        side = kSide;
+      }
+    }
+  }
+  result.coordinate[axis] = side < 0 ? min_[axis] : max_[axis];
+  result.normal[axis] = side;
   intersection = result;
-  return true;
+}
+auto Cuboid::IntersectP(Ray const& ray) const -> bool {
+  double t = 0;
+  return HitDistance(ray, t);
 }
 auto Cuboid::GetBounds() -> Box { return {min_, max_}; }
+void Cuboid::Translate(math::Vector3d const& offset) {
+  min_ += offset;
+  max_ += offset;
+}
+void Cuboid::BindMaterials(MaterialTable& materials) {
+  material_id_ = materials.Add(material_);
+}
 void Cuboid::Sample(Intersection& intersection, double& pdf) {
   auto const d = max_ - min_;
   auto const area_yz = d.y * d.z;
@@ -86,7 +111,7 @@ void Cuboid::Sample(Intersection& intersection, double& pdf) {
     intersection.normal = {0, 0, 1};
   }
 
-  intersection.material = material_;
+  intersection.material = material_id_;
   pdf = 1.0 / total_area;
 }
 auto Cuboid::HasEmission() const -> bool {
@@ -10,16 +10,17 @@
 
 #include "object/primitive/plane.h"
 
+#include <array>
+
 #include "utility/constant.h"
 #include "utility/random.h"
 
 namespace cherry {
-auto Plane::Intersect(Ray const& ray, Intersection& intersection) const
-    -> bool {
+auto Plane::HitDistance(Ray const& ray, double& t) const -> bool {
   if (ray.direction.Dot(normal_) > 0) return false;
   auto const kT =
       normal_.Dot(position_ - ray.origin) / normal_.Dot(ray.direction);
-  if (kT < 0) return false;
+  if (kT < ray.t_min || kT > ray.t_max) return false;
   if (e1_.Norm2() > EPSILON && e2_.Norm2() > EPSILON) {
     auto const kP = ray(kT);
     auto const kE = kP - position_;
@@ -27,20 +28,64 @@ auto Plane::Intersect(Ray const& ray, Intersection& intersection) const
     auto const kT2 = kE.Dot(e2_) / e2_.Norm2();
     if (kT1 < 0.0 || kT1 > 1.0 || kT2 < 0.0 || kT2 > 1.0) return false;
   }
-  intersection.coordinate = ray(kT);
-  intersection.material = material_;
-  intersection.distance = kT;
-  intersection.normal = normal_;
+  t = kT;
+  return true;
+}
+auto Plane::Intersect(Ray const& ray, HitRecord& record) const -> bool {
+  double t = 0;
+  if (!HitDistance(ray, t)) return false;
+  record = {.distance = t, .object = this};
   return true;
 }
-auto Plane::GetBounds() -> Box { return {position_, position_ + e1_ + e2_}; }
+void Plane::ComputeIntersection(Ray const& ray, HitRecord const& record,
+                                Intersection& intersection) const {
+  // projected back onto the plane, which bounds its error whatever the error
+  // of the distance
+  auto const kPoint = ray(record.distance);
+  intersection.coordinate =
+      kPoint - normal_ * (normal_.Dot(kPoint - position_) / normal_.Norm2());
+  intersection.error =
+      (intersection.coordinate.Abs() + position_.Abs()) * Gamma(5);
+  intersection.material = material_id_;
+  intersection.distance = record.distance;
+  intersection.normal = normal_;
+}
+auto Plane::IntersectP(Ray const& ray) const -> bool {
+  double t = 0;
+  return HitDistance(ray, t);
+}
+auto Plane::GetBounds() -> Box {
+  if (e1_.Norm2() < EPSILON || e2_.Norm2() < EPSILON) [[unlikely]] {
+    // unbounded plane
+    auto const kMax = std::numeric_limits<double>::max();
+    return {math::Vector3d(-kMax), math::Vector3d(kMax)};
+  }
+  Box bounds(position_);
+  bounds = bounds.Union(Box(position_ + e1_));
+  bounds = bounds.Union(Box(position_ + e2_));
+  return bounds.Union(Box(position_ + e1_ + e2_));
+}
+void Plane::Translate(math::Vector3d const& offset) { position_ += offset; }
+void Plane::BindMaterials(MaterialTable& materials) {
+  material_id_ = materials.Add(material_);
+}
+auto Plane::ClipBounds(Box const& clip) -> Box {
+  if (e1_.Norm2() < EPSILON || e2_.Norm2() < EPSILON) [[unlikely]]
+    return GetBounds().Clip(clip);
+  std::array<math::Point3, 4> const kCorners = {
+      position_, position_ + e1_, position_ + e1_ + e2_, position_ + e2_};
+  return ClippedBounds(kCorners, clip);
+}
+void Plane::AppendClipPoints(std::vector<math::Point3>& points) const {
+  points.insert(points.end(), {position_, e1_, e2_});
+}
 void Plane::Sample(Intersection& intersection, double& pdf) {
   if (e1_.Norm2() < EPSILON || e2_.Norm2() < EPSILON) [[unlikely]] {
   } else [[likely]] {
     auto const kR1 = GetRandomDouble();
     auto const kR2 = GetRandomDouble();
     intersection.coordinate = position_ + e1_ * kR1 + e2_ * kR2;
-    intersection.material = material_;
+    intersection.material = material_id_;
     intersection.normal = normal_;
     pdf = 1.0 / GetSurfaceArea();
   }
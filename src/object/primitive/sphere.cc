@@ -16,8 +16,7 @@
 #include "utility/random.h"
 
 namespace cherry {
-auto Sphere::Intersect(const Ray& ray, Intersection& intersection) const
-    -> bool {
+auto Sphere::HitDistance(const Ray& ray, double& t) const -> bool {
   auto const kL = ray.origin - center_;
   auto const kA = ray.direction.Norm2();
   auto const kB = 2 * ray.direction.Dot(kL);
@@ -25,21 +24,43 @@ auto Sphere::Intersect(const Ray& ray, Intersection& intersection) const
   double t0 = 0;
   double t1 = 0;
   if (!SolveQuadratic(kA, kB, kC, t0, t1)) return false;
-  if (t0 < 1e-2) t0 = t1;
-  if (t0 < 1e-1) return false;
-
+  if (t0 < ray.t_min) t0 = t1;
+  if (t0 < ray.t_min || t0 > ray.t_max) return false;
+  t = t0;
+  return true;
+}
+auto Sphere::Intersect(const Ray& ray, HitRecord& record) const -> bool {
+  double t0 = 0;
+  if (!HitDistance(ray, t0)) return false;
+  record = {.distance = t0, .object = this};
+  return true;
+}
+void Sphere::ComputeIntersection(const Ray& ray, const HitRecord& record,
+                                 Intersection& intersection) const {
   Intersection result;
-  result.coordinate = math::Vector3d(ray.origin + ray.direction * t0);
-  result.normal = math::Vector3d(result.coordinate - center_).Normalized();
-  result.material = this->material_;
-  result.distance = t0;
+  // projected back onto the sphere, which bounds its error whatever the
+  // error of the distance
+  auto offset = ray(record.distance) - center_;
+  offset *= radius_ / offset.Norm();
+  result.coordinate = center_ + offset;
+  result.error = (offset.Abs() + center_.Abs()) * Gamma(6);
+  result.normal = offset.Normalized();
+  result.material = material_id_;
+  result.distance = record.distance;
   intersection = result;
-  return true;
+}
+auto Sphere::IntersectP(const Ray& ray) const -> bool {
+  double t = 0;
+  return HitDistance(ray, t);
 }
 auto Sphere::GetBounds() -> Box {
   auto const kR = math::Vector3d(radius_);
   return {center_ - kR, center_ + kR};
 }
+void Sphere::Translate(math::Vector3d const& offset) { center_ += offset; }
+void Sphere::BindMaterials(MaterialTable& materials) {
+  material_id_ = materials.Add(material_);
+}
 void Sphere::Sample(Intersection& pos, double& pdf) {
   auto const u1 = GetRandomDouble();
   auto const u2 = GetRandomDouble();
@@ -49,7 +70,7 @@ void Sphere::Sample(Intersection& pos, double& pdf) {
   math::Vector3d const dir(r * std::cos(phi), r * std::sin(phi), z);
   pos.coordinate = center_ + radius_ * dir;
   pos.normal = dir;
-  pos.material = material_;
+  pos.material = material_id_;
   pdf = 1.0 / GetSurfaceArea();
 }
 auto Sphere::HasEmission() const -> bool {
@@ -1,12 +1,14 @@
 #include "object/primitive/triangle.h"
 
+#include <array>
+
 #include "core/material.h"
 #include "utility/constant.h"
 #include "utility/random.h"
 
 namespace cherry {
-auto Triangle::Intersect(const Ray& ray, Intersection& intersection) const
-    -> bool {
+auto Triangle::HitDistance(const Ray& ray, double& t, double& b1,
+                           double& b2) const -> bool {
   if (normal_.Dot(ray.direction) > 0) return false;
   auto const kPVec = ray.direction.Cross(e2_);
   auto const kDet = e1_.Dot(kPVec);
@@ -17,20 +19,44 @@ auto Triangle::Intersect(const Ray& ray, Intersection& intersection) const
   double const kU = kTVec.Dot(kPVec) * kDetInv;
   if (kU < 0 || kU > 1) return false;
   auto const kQVec = kTVec.Cross(e1_);
-  if (double const kV = ray.direction.Dot(kQVec) * kDetInv;
-      kV < 0 || kU + kV > 1)
-    return false;
+  double const kV = ray.direction.Dot(kQVec) * kDetInv;
+  if (kV < 0 || kU + kV > 1) return false;
   double const kTTmp = e2_.Dot(kQVec) * kDetInv;
 
-  if (kTTmp < 0) return false;
-
-  intersection.coordinate = ray(kTTmp);
-  intersection.distance = kTTmp;
-  intersection.material = material_;
-  intersection.normal = normal_;
-
+  if (kTTmp < ray.t_min || kTTmp > ray.t_max) return false;
+  t = kTTmp;
+  b1 = kU;
+  b2 = kV;
   return true;
 }
+auto Triangle::Intersect(const Ray& ray, HitRecord& record) const -> bool {
+  double t = 0;
+  double b1 = 0;
+  double b2 = 0;
+  if (!HitDistance(ray, t, b1, b2)) return false;
+  record = {.distance = t, .object = this, .b1 = b1, .b2 = b2};
+  return true;
+}
+void Triangle::ComputeIntersection(const Ray& /*ray*/,
+                                   const HitRecord& record,
+                                   Intersection& intersection) const {
+  // interpolated from the vertices, whose error does not grow with the
+  // distance along the ray
+  auto const kP0 = v0_ * (1.0 - record.b1 - record.b2);
+  auto const kP1 = v1_ * record.b1;
+  auto const kP2 = v2_ * record.b2;
+  intersection.coordinate = kP0 + kP1 + kP2;
+  intersection.error = (kP0.Abs() + kP1.Abs() + kP2.Abs()) * Gamma(7);
+  intersection.distance = record.distance;
+  intersection.material = material_id_;
+  intersection.normal = normal_;
+}
+auto Triangle::IntersectP(const Ray& ray) const -> bool {
+  double t = 0;
+  double b1 = 0;
+  double b2 = 0;
+  return HitDistance(ray, t, b1, b2);
+}
 auto Triangle::GetBounds() -> Box {
   auto const kMin1 = math::Min(v0_, v1_);
   auto min = math::Min(kMin1, v2_);
@@ -38,13 +64,28 @@ auto Triangle::GetBounds() -> Box {
   auto max = math::Max(kMax1, v2_);
   return {min, max};
 }
+void Triangle::Translate(math::Vector3d const& offset) {
+  v0_ += offset;
+  v1_ += offset;
+  v2_ += offset;
+}
+void Triangle::BindMaterials(MaterialTable& materials) {
+  material_id_ = materials.Add(material_);
+}
+auto Triangle::ClipBounds(Box const& clip) -> Box {
+  std::array<math::Point3, 3> const kVertices = {v0_, v1_, v2_};
+  return ClippedBounds(kVertices, clip);
+}
+void Triangle::AppendClipPoints(std::vector<math::Point3>& points) const {
+  points.insert(points.end(), {v0_, v1_, v2_});
+}
 void Triangle::Sample(Intersection& intersection, double& pdf) {
   auto const kX = std::sqrt(GetRandomDouble());
   auto const kY = GetRandomDouble();
   intersection.coordinate =
       v0_ * (1.0 - kX) + v1_ * (kX * (1.0 - kY)) + v2_ * (kX * kY);
   intersection.normal = this->normal_;
-  intersection.material = material_;
+  intersection.material = material_id_;
   pdf = 1.0 / GetSurfaceArea();
 }
 auto Triangle::HasEmission() const -> bool {
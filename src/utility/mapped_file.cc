@@ -0,0 +1,88 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : mapped_file.cc
+// Author      : QRWells
+// Created at  : 2026/10/18 21:12
+// Description : Read-only memory mapping of a whole file
+
+#include <utility>
+
+#include "utility/mapped_file.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cherry {
+#if defined(_WIN32)
+MappedFile::MappedFile(std::filesystem::path const& path) {
+  auto* const kFile =
+      CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (kFile == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(kFile, &size) && size.QuadPart > 0) {
+    auto* const kMapping =
+        CreateFileMappingW(kFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (kMapping != nullptr) {
+      auto* const kView = MapViewOfFile(kMapping, FILE_MAP_READ, 0, 0, 0);
+      if (kView != nullptr) {
+        data_ = static_cast<std::byte const*>(kView);
+        size_ = static_cast<size_t>(size.QuadPart);
+      }
+      // the view keeps the mapping alive
+      CloseHandle(kMapping);
+    }
+  }
+  CloseHandle(kFile);
+}
+
+void MappedFile::Unmap() {
+  if (data_ != nullptr) UnmapViewOfFile(data_);
+}
+#else
+MappedFile::MappedFile(std::filesystem::path const& path) {
+  auto const kFile = open(path.c_str(), O_RDONLY);
+  if (kFile < 0) return;
+  struct stat status {};
+  if (fstat(kFile, &status) == 0 && status.st_size > 0) {
+    auto const kSize = static_cast<size_t>(status.st_size);
+    auto* const kView = mmap(nullptr, kSize, PROT_READ, MAP_SHARED, kFile, 0);
+    if (kView != MAP_FAILED) {
+      data_ = static_cast<std::byte const*>(kView);
+      size_ = kSize;
+    }
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(kFile);
+}
+
+void MappedFile::Unmap() {
+  if (data_ != nullptr) munmap(const_cast<std::byte*>(data_), size_);
+}
+#endif
+
+MappedFile::~MappedFile() { Unmap(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile& {
+  if (this != &other) {
+    Unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+}  // namespace cherry
@@ -0,0 +1,684 @@
+// Copyright (c) 2021 QRWells. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// This file is part of Project Cherry.
+// File Name   : mesh_file.cc
+// Author      : QRWells
+// Created at  : 2026/10/19 2:05
+// Description : Parallel readers of OBJ and PLY triangle meshes
+
+#include "utility/mesh_file.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "utility/mapped_file.h"
+
+namespace cherry {
+namespace {
+// bytes of OBJ text parsed by one task
+constexpr size_t kObjChunkSize = size_t{1} << 22;
+
+// position, texture coordinate and normal indices of a face corner, 1-based
+// with 0 for an attribute the corner does not have
+using ObjCorner = std::array<uint32_t, 3>;
+
+struct ObjCornerHash {
+  auto operator()(ObjCorner const& corner) const -> size_t {
+    return (corner[0] * 0x9e3779b97f4a7c15ULL) ^
+           (corner[1] * 0xc2b2ae3d27d4eb4fULL) ^ corner[2];
+  }
+};
+
+enum class ObjStatement : uint8_t { kOther, kPosition, kUv, kNormal, kFace };
+
+// vertex statements of a range of lines, or the ones before it
+struct ObjCounts {
+  uint64_t positions = 0;
+  uint64_t uvs = 0;
+  uint64_t normals = 0;
+};
+
+auto IsBlank(char c) -> bool { return c == ' ' || c == '\t' || c == '\r'; }
+
+auto SkipBlanks(char const* text, char const* end) -> char const* {
+  while (text < end && IsBlank(*text)) ++text;
+  return text;
+}
+
+// statement of the line, text is moved past its keyword
+auto Classify(char const*& text, char const* end) -> ObjStatement {
+  text = SkipBlanks(text, end);
+  if (end - text < 2) return ObjStatement::kOther;
+  if (text[0] == 'f' && IsBlank(text[1])) {
+    text += 2;
+    return ObjStatement::kFace;
+  }
+  if (text[0] != 'v') return ObjStatement::kOther;
+  if (IsBlank(text[1])) {
+    text += 2;
+    return ObjStatement::kPosition;
+  }
+  if (end - text < 3 || !IsBlank(text[2])) return ObjStatement::kOther;
+  auto const kKind = text[1];
+  text += 3;
+  if (kKind == 't') return ObjStatement::kUv;
+  if (kKind == 'n') return ObjStatement::kNormal;
+  return ObjStatement::kOther;
+}
+
+// calls visit(statement, text, line_end) for every line in [begin, end)
+template <typename Visitor>
+void ForEachLine(char const* begin, char const* end, Visitor&& visit) {
+  while (begin < end) {
+    auto const* line_end = static_cast<char const*>(
+        std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+    if (line_end == nullptr) line_end = end;
+    auto const* text = begin;
+    auto const kStatement = Classify(text, line_end);
+    visit(kStatement, text, line_end);
+    begin = line_end + 1;
+  }
+}
+
+// start of the first line beginning at or after offset
+auto LineStart(std::string_view text, size_t offset) -> size_t {
+  if (offset == 0) return 0;
+  if (offset >= text.size()) return text.size();
+  auto const kNewline = text.find('\n', offset - 1);
+  return kNewline == std::string_view::npos ? text.size() : kNewline + 1;
+}
+
+auto ParseDouble(char const*& text, char const* end, double& value) -> bool {
+  text = SkipBlanks(text, end);
+  if (text < end && *text == '+') ++text;
+  auto const [kPtr, kError] = std::from_chars(text, end, value);
+  if (kError != std::errc()) return false;
+  text = kPtr;
+  return true;
+}
+
+auto ParseIndex(char const*& text, char const* end, int64_t& value) -> bool {
+  auto const [kPtr, kError] = std::from_chars(text, end, value);
+  if (kError != std::errc()) return false;
+  text = kPtr;
+  return true;
+}
+
+/**
+ * @brief 1-based index of a corner attribute, 0 if it is out of range
+ *
+ * @param seen elements before the line, relative indices count back from it
+ * @param total elements in the file
+ */
+auto ResolveObjIndex(int64_t index, uint64_t seen, uint64_t total)
+    -> uint32_t {
+  if (index < 0) index += static_cast<int64_t>(seen) + 1;
+  if (index <= 0 || static_cast<uint64_t>(index) > total) return 0;
+  return static_cast<uint32_t>(index);
+}
+
+// the corners of the faces in a chunk, three per triangle
+void ParseObjChunk(char const* begin, char const* end, ObjCounts seen,
+                   ObjCounts const& total, MeshData& mesh,
+                   std::vector<ObjCorner>& corners) {
+  std::vector<ObjCorner> face;
+  ForEachLine(begin, end, [&](ObjStatement statement, char const* text,
+                              char const* line_end) {
+    std::array<double, 3> values{};
+    switch (statement) {
+      case ObjStatement::kPosition:
+        // a malformed statement still takes its index
+        for (auto& value : values)
+          if (!ParseDouble(text, line_end, value)) break;
+        mesh.positions[seen.positions++] = {values[0], values[1], values[2]};
+        break;
+      case ObjStatement::kUv:
+        for (int i = 0; i < 2; ++i)
+          if (!ParseDouble(text, line_end, values[i])) break;
+        mesh.uvs[seen.uvs++] = {values[0], values[1]};
+        break;
+      case ObjStatement::kNormal:
+        for (auto& value : values)
+          if (!ParseDouble(text, line_end, value)) break;
+        mesh.normals[seen.normals++] = {values[0], values[1], values[2]};
+        break;
+      case ObjStatement::kFace: {
+        // v, v/vt, v//vn or v/vt/vn per corner
+        face.clear();
+        while (true) {
+          text = SkipBlanks(text, line_end);
+          int64_t index = 0;
+          if (!ParseIndex(text, line_end, index)) break;
+          ObjCorner corner = {
+              ResolveObjIndex(index, seen.positions, total.positions), 0, 0};
+          if (text < line_end && *text == '/') {
+            ++text;
+            if (ParseIndex(text, line_end, index))
+              corner[1] = ResolveObjIndex(index, seen.uvs, total.uvs);
+            if (text < line_end && *text == '/') {
+              ++text;
+              if (ParseIndex(text, line_end, index))
+                corner[2] = ResolveObjIndex(index, seen.normals, total.normals);
+            }
+          }
+          if (corner[0] == 0) break;
+          face.push_back(corner);
+        }
+        for (size_t i = 2; i < face.size(); ++i) {
+          corners.push_back(face[0]);
+          corners.push_back(face[i - 1]);
+          corners.push_back(face[i]);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  });
+}
+
+// turns the face corners into vertices, merging corners with equal indices
+void BuildObjVertices(std::vector<ObjCorner> const& corners, MeshData& mesh) {
+  auto const kCount = static_cast<int64_t>(corners.size());
+  bool has_uvs = true;
+  bool has_normals = true;
+#pragma omp parallel for reduction(&& : has_uvs, has_normals)
+  for (int64_t i = 0; i < kCount; ++i) {
+    has_uvs = has_uvs && corners[i][1] != 0;
+    has_normals = has_normals && corners[i][2] != 0;
+  }
+  // attributes only some corners have are dropped
+  bool shared_indices = true;
+#pragma omp parallel for reduction(&& : shared_indices)
+  for (int64_t i = 0; i < kCount; ++i) {
+    shared_indices = shared_indices &&
+                     (!has_uvs || corners[i][1] == corners[i][0]) &&
+                     (!has_normals || corners[i][2] == corners[i][0]);
+  }
+
+  mesh.vertex_index.resize(corners.size());
+  if (shared_indices) {
+    // the position index already names the vertex
+#pragma omp parallel for
+    for (int64_t i = 0; i < kCount; ++i)
+      mesh.vertex_index[i] = corners[i][0] - 1;
+    if (has_uvs)
+      mesh.uvs.resize(mesh.positions.size());
+    else
+      mesh.uvs.clear();
+    if (has_normals)
+      mesh.normals.resize(mesh.positions.size());
+    else
+      mesh.normals.clear();
+  } else {
+    MeshData merged;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertices;
+    for (int64_t i = 0; i < kCount; ++i) {
+      auto key = corners[i];
+      if (!has_uvs) key[1] = 0;
+      if (!has_normals) key[2] = 0;
+      auto const [kIt, kInserted] = vertices.try_emplace(
+          key, static_cast<uint32_t>(merged.positions.size()));
+      if (kInserted) {
+        merged.positions.push_back(mesh.positions[key[0] - 1]);
+        if (has_uvs) merged.uvs.push_back(mesh.uvs[key[1] - 1]);
+        if (has_normals) merged.normals.push_back(mesh.normals[key[2] - 1]);
+      }
+      mesh.vertex_index[i] = kIt->second;
+    }
+    mesh.positions.swap(merged.positions);
+    mesh.uvs.swap(merged.uvs);
+    mesh.normals.swap(merged.normals);
+  }
+
+  auto const kNormals = static_cast<int64_t>(mesh.normals.size());
+#pragma omp parallel for
+  for (int64_t i = 0; i < kNormals; ++i) {
+    if (mesh.normals[i].Norm2() > 0)
+      mesh.normals[i] = mesh.normals[i].Normalized();
+  }
+}
+
+enum class PlyType : uint8_t {
+  kInt8,
+  kUint8,
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kFloat32,
+  kFloat64,
+};
+
+struct PlyProperty {
+  std::string name;
+  PlyType type{};
+  // lists store their length as count_type, then that many values of type
+  bool is_list = false;
+  PlyType count_type{};
+};
+
+struct PlyElement {
+  std::string name;
+  uint64_t count = 0;
+  std::vector<PlyProperty> properties;
+};
+
+auto ParsePlyType(std::string const& name) -> std::optional<PlyType> {
+  static std::unordered_map<std::string, PlyType> const kTypes = {
+      {"char", PlyType::kInt8},      {"int8", PlyType::kInt8},
+      {"uchar", PlyType::kUint8},    {"uint8", PlyType::kUint8},
+      {"short", PlyType::kInt16},    {"int16", PlyType::kInt16},
+      {"ushort", PlyType::kUint16},  {"uint16", PlyType::kUint16},
+      {"int", PlyType::kInt32},      {"int32", PlyType::kInt32},
+      {"uint", PlyType::kUint32},    {"uint32", PlyType::kUint32},
+      {"float", PlyType::kFloat32},  {"float32", PlyType::kFloat32},
+      {"double", PlyType::kFloat64}, {"float64", PlyType::kFloat64},
+  };
+  auto const kIt = kTypes.find(name);
+  if (kIt == kTypes.end()) return std::nullopt;
+  return kIt->second;
+}
+
+auto PlySize(PlyType type) -> size_t {
+  switch (type) {
+    case PlyType::kInt8:
+    case PlyType::kUint8:
+      return 1;
+    case PlyType::kInt16:
+    case PlyType::kUint16:
+      return 2;
+    case PlyType::kFloat64:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+template <typename T>
+auto LoadScalar(std::byte const* data, bool swap) -> T {
+  std::array<std::byte, sizeof(T)> bytes{};
+  std::memcpy(bytes.data(), data, sizeof(T));
+  if (swap) std::ranges::reverse(bytes);
+  return std::bit_cast<T>(bytes);
+}
+
+auto LoadPly(std::byte const* data, PlyType type, bool swap) -> double {
+  switch (type) {
+    case PlyType::kInt8:
+      return LoadScalar<int8_t>(data, swap);
+    case PlyType::kUint8:
+      return LoadScalar<uint8_t>(data, swap);
+    case PlyType::kInt16:
+      return LoadScalar<int16_t>(data, swap);
+    case PlyType::kUint16:
+      return LoadScalar<uint16_t>(data, swap);
+    case PlyType::kInt32:
+      return LoadScalar<int32_t>(data, swap);
+    case PlyType::kUint32:
+      return LoadScalar<uint32_t>(data, swap);
+    case PlyType::kFloat32:
+      return LoadScalar<float>(data, swap);
+    default:
+      return LoadScalar<double>(data, swap);
+  }
+}
+
+/**
+ * @brief Parse the header up to end_header
+ *
+ * @param data_offset set to the first byte of the element data
+ * @param swap set if the data is stored in the other byte order
+ */
+auto ParsePlyHeader(std::string_view text, std::vector<PlyElement>& elements,
+                    size_t& data_offset, bool& swap) -> bool {
+  auto const kEnd = text.find("end_header");
+  if (!text.starts_with("ply") || kEnd == std::string_view::npos) return false;
+  auto const kNewline = text.find('\n', kEnd);
+  if (kNewline == std::string_view::npos) return false;
+  data_offset = kNewline + 1;
+
+  std::istringstream header{std::string(text.substr(0, kEnd))};
+  std::string line;
+  bool binary = false;
+  while (std::getline(header, line)) {
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      auto const kLittle = std::endian::native == std::endian::little;
+      binary = format == "binary_little_endian" ||
+               format == "binary_big_endian";
+      swap = (format == "binary_little_endian") != kLittle;
+    } else if (keyword == "element") {
+      auto& element = elements.emplace_back();
+      tokens >> element.name >> element.count;
+    } else if (keyword == "property") {
+      if (elements.empty()) return false;
+      std::string type;
+      tokens >> type;
+      PlyProperty property;
+      if (type == "list") {
+        std::string count_type;
+        tokens >> count_type >> type;
+        auto const kCountType = ParsePlyType(count_type);
+        if (!kCountType) return false;
+        property.is_list = true;
+        property.count_type = *kCountType;
+      }
+      auto const kType = ParsePlyType(type);
+      if (!kType) return false;
+      property.type = *kType;
+      tokens >> property.name;
+      elements.back().properties.push_back(std::move(property));
+    }
+  }
+  return binary;
+}
+
+// bytes of a record without lists, 0 if it has one
+auto PlyStride(PlyElement const& element) -> size_t {
+  size_t stride = 0;
+  for (auto const& property : element.properties) {
+    if (property.is_list) return 0;
+    stride += PlySize(property.type);
+  }
+  return stride;
+}
+
+// bytes of the property value at data, nullopt if it runs past the end
+auto PlyValueSize(std::span<std::byte const> data, PlyProperty const& property,
+                  bool swap) -> std::optional<size_t> {
+  auto size = PlySize(property.is_list ? property.count_type : property.type);
+  if (size > data.size()) return std::nullopt;
+  if (property.is_list) {
+    auto const kLength = static_cast<size_t>(
+        LoadPly(data.data(), property.count_type, swap));
+    size += kLength * PlySize(property.type);
+    if (size > data.size()) return std::nullopt;
+  }
+  return size;
+}
+
+// bytes of the first record in data, nullopt if it runs past the end
+auto PlyRecordSize(std::span<std::byte const> data, PlyElement const& element,
+                   bool swap) -> std::optional<size_t> {
+  size_t size = 0;
+  for (auto const& property : element.properties) {
+    auto const kSize = PlyValueSize(data.subspan(size), property, swap);
+    if (!kSize) return std::nullopt;
+    size += *kSize;
+  }
+  return size;
+}
+
+// decodes the vertex element, whose records have a fixed size
+auto ReadPlyVertices(std::span<std::byte const> data,
+                     PlyElement const& element, bool swap, MeshData& mesh)
+    -> bool {
+  auto const kStride = PlyStride(element);
+  if (kStride == 0 || data.size() < element.count * kStride) return false;
+
+  // byte offset and type of a property, nullopt if the element lacks it
+  auto const kFind = [&](std::initializer_list<std::string_view> names)
+      -> std::optional<std::pair<size_t, PlyType>> {
+    size_t offset = 0;
+    for (auto const& property : element.properties) {
+      if (std::ranges::find(names, property.name) != names.end())
+        return std::pair{offset, property.type};
+      offset += PlySize(property.type);
+    }
+    return std::nullopt;
+  };
+  std::array const kPosition = {kFind({"x"}), kFind({"y"}), kFind({"z"})};
+  std::array const kNormal = {kFind({"nx"}), kFind({"ny"}), kFind({"nz"})};
+  std::array const kUv = {
+      kFind({"u", "s", "texture_u", "texture_s"}),
+      kFind({"v", "t", "texture_v", "texture_t"}),
+  };
+  auto const kHas = [](auto const& fields) {
+    return std::ranges::all_of(
+        fields, [](auto const& field) { return field.has_value(); });
+  };
+  if (!kHas(kPosition)) return false;
+  auto const kHasNormals = kHas(kNormal);
+  auto const kHasUvs = kHas(kUv);
+
+  auto const kCount = static_cast<int64_t>(element.count);
+  mesh.positions.resize(element.count);
+  mesh.normals.resize(kHasNormals ? element.count : 0);
+  mesh.uvs.resize(kHasUvs ? element.count : 0);
+#pragma omp parallel for schedule(static, 4096)
+  for (int64_t i = 0; i < kCount; ++i) {
+    auto const* record = data.data() + i * kStride;
+    auto const kLoad = [&](auto const& field) {
+      return LoadPly(record + field->first, field->second, swap);
+    };
+    for (int k = 0; k < 3; ++k) mesh.positions[i][k] = kLoad(kPosition[k]);
+    if (kHasNormals) {
+      math::Vector3d normal;
+      for (int k = 0; k < 3; ++k) normal[k] = kLoad(kNormal[k]);
+      mesh.normals[i] = normal.Norm2() > 0 ? normal.Normalized() : normal;
+    }
+    if (kHasUvs) mesh.uvs[i] = {kLoad(kUv[0]), kLoad(kUv[1])};
+  }
+  return true;
+}
+
+// decodes the face element into triangle fans, faces with a vertex out of
+// range are dropped
+// @return bytes of the element, 0 if it cannot be read
+auto ReadPlyFaces(std::span<std::byte const> data, PlyElement const& element,
+                  bool swap, MeshData& mesh) -> size_t {
+  PlyProperty const* indices = nullptr;
+  // bytes before the index list and of the other properties, as long as
+  // the index list is the only list
+  size_t list_offset = 0;
+  size_t scalar_bytes = 0;
+  bool other_lists = false;
+  for (auto const& property : element.properties) {
+    if (property.name == "vertex_indices" || property.name == "vertex_index") {
+      indices = &property;
+    } else if (property.is_list) {
+      other_lists = true;
+    } else {
+      scalar_bytes += PlySize(property.type);
+      if (indices == nullptr) list_offset += PlySize(property.type);
+    }
+  }
+  if (indices == nullptr || !indices->is_list) return 0;
+
+  auto const kVertexCount = mesh.positions.size();
+  auto const kIndexSize = PlySize(indices->type);
+  auto const kLoadIndex = [&](std::byte const* values, size_t k) {
+    return static_cast<int64_t>(
+        LoadPly(values + k * kIndexSize, indices->type, swap));
+  };
+  auto const kInRange = [&](int64_t index) {
+    return index >= 0 && static_cast<uint64_t>(index) < kVertexCount;
+  };
+
+  // triangle meshes, the common case, have records of a fixed size
+  auto const kFaces = static_cast<int64_t>(element.count);
+  auto const kCountSize = PlySize(indices->count_type);
+  auto const kTriangleStride = scalar_bytes + kCountSize + 3 * kIndexSize;
+  bool all_triangles =
+      !other_lists && data.size() >= element.count * kTriangleStride;
+  if (all_triangles) {
+#pragma omp parallel for reduction(&& : all_triangles)
+    for (int64_t i = 0; i < kFaces; ++i) {
+      auto const* list = data.data() + i * kTriangleStride + list_offset;
+      all_triangles =
+          all_triangles && LoadPly(list, indices->count_type, swap) == 3;
+    }
+  }
+
+  if (all_triangles) {
+    mesh.vertex_index.resize(3 * element.count);
+    bool valid = true;
+#pragma omp parallel for schedule(static, 4096) reduction(&& : valid)
+    for (int64_t i = 0; i < kFaces; ++i) {
+      auto const* values =
+          data.data() + i * kTriangleStride + list_offset + kCountSize;
+      for (size_t k = 0; k < 3; ++k) {
+        auto const kIndex = kLoadIndex(values, k);
+        valid = valid && kInRange(kIndex);
+        mesh.vertex_index[3 * i + k] = static_cast<uint32_t>(kIndex);
+      }
+    }
+    if (!valid) {
+      size_t kept = 0;
+      for (size_t t = 0; t < element.count; ++t) {
+        auto const* triangle = &mesh.vertex_index[3 * t];
+        if (std::all_of(triangle, triangle + 3,
+                        [&](uint32_t v) { return v < kVertexCount; }))
+          std::copy_n(triangle, 3, &mesh.vertex_index[3 * kept++]);
+      }
+      mesh.vertex_index.resize(3 * kept);
+    }
+    return element.count * kTriangleStride;
+  }
+
+  // polygons of any size, walked record by record
+  size_t offset = 0;
+  for (uint64_t i = 0; i < element.count; ++i) {
+    auto const kRecord = data.subspan(offset);
+    auto const kSize = PlyRecordSize(kRecord, element, swap);
+    if (!kSize) return 0;
+    offset += *kSize;
+
+    size_t position = 0;
+    for (auto const* property = element.properties.data(); property != indices;
+         ++property)
+      position += *PlyValueSize(kRecord.subspan(position), *property, swap);
+    auto const* list = kRecord.data() + position;
+    auto const kLength =
+        static_cast<size_t>(LoadPly(list, indices->count_type, swap));
+    auto const* values = list + kCountSize;
+    bool valid = true;
+    for (size_t k = 0; k < kLength; ++k)
+      valid = valid && kInRange(kLoadIndex(values, k));
+    if (!valid) continue;
+    for (size_t k = 2; k < kLength; ++k) {
+      for (auto const kCorner : {size_t{0}, k - 1, k})
+        mesh.vertex_index.push_back(
+            static_cast<uint32_t>(kLoadIndex(values, kCorner)));
+    }
+  }
+  return offset;
+}
+}  // namespace
+
+auto ReadObj(std::filesystem::path const& path, MeshData& mesh) -> bool {
+  MappedFile const kFile(path);
+  if (!kFile.IsOpen()) return false;
+  std::string_view const kText(
+      reinterpret_cast<char const*>(kFile.Bytes().data()),
+      kFile.Bytes().size());
+
+  auto const kChunks = static_cast<int64_t>(
+      (kText.size() + kObjChunkSize - 1) / kObjChunkSize);
+  std::vector<size_t> bounds(kChunks + 1);
+  for (int64_t c = 0; c <= kChunks; ++c)
+    bounds[c] = LineStart(kText, c * kObjChunkSize);
+
+  // first pass: vertex statements per chunk, turned into the counts before
+  // every chunk
+  std::vector<ObjCounts> seen(kChunks + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c = 0; c < kChunks; ++c) {
+    auto& counts = seen[c + 1];
+    ForEachLine(kText.data() + bounds[c], kText.data() + bounds[c + 1],
+                [&counts](ObjStatement statement, char const*, char const*) {
+                  counts.positions += statement == ObjStatement::kPosition;
+                  counts.uvs += statement == ObjStatement::kUv;
+                  counts.normals += statement == ObjStatement::kNormal;
+                });
+  }
+  for (int64_t c = 0; c < kChunks; ++c) {
+    seen[c + 1].positions += seen[c].positions;
+    seen[c + 1].uvs += seen[c].uvs;
+    seen[c + 1].normals += seen[c].normals;
+  }
+  auto const& total = seen.back();
+  if (total.positions > UINT32_MAX) return false;
+
+  // second pass: vertices straight to their place, faces per chunk
+  mesh = {};
+  mesh.positions.resize(total.positions);
+  mesh.uvs.resize(total.uvs);
+  mesh.normals.resize(total.normals);
+  std::vector<std::vector<ObjCorner>> chunk_corners(kChunks);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c = 0; c < kChunks; ++c) {
+    ParseObjChunk(kText.data() + bounds[c], kText.data() + bounds[c + 1],
+                  seen[c], total, mesh, chunk_corners[c]);
+  }
+
+  std::vector<size_t> corner_offsets(kChunks + 1);
+  for (int64_t c = 0; c < kChunks; ++c)
+    corner_offsets[c + 1] = corner_offsets[c] + chunk_corners[c].size();
+  if (corner_offsets.back() == 0) return false;
+  std::vector<ObjCorner> corners(corner_offsets.back());
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c = 0; c < kChunks; ++c) {
+    std::ranges::copy(chunk_corners[c], corners.begin() + corner_offsets[c]);
+    std::vector<ObjCorner>().swap(chunk_corners[c]);
+  }
+
+  BuildObjVertices(corners, mesh);
+  return true;
+}
+
+auto ReadPly(std::filesystem::path const& path, MeshData& mesh) -> bool {
+  MappedFile const kFile(path);
+  if (!kFile.IsOpen()) return false;
+  auto const kBytes = kFile.Bytes();
+
+  std::vector<PlyElement> elements;
+  size_t offset = 0;
+  bool swap = false;
+  std::string_view const kText(reinterpret_cast<char const*>(kBytes.data()),
+                               kBytes.size());
+  if (!ParsePlyHeader(kText, elements, offset, swap)) return false;
+
+  mesh = {};
+  bool has_vertices = false;
+  for (auto const& element : elements) {
+    auto const kData = kBytes.subspan(offset);
+    if (element.name == "vertex") {
+      if (!ReadPlyVertices(kData, element, swap, mesh)) return false;
+      has_vertices = true;
+      offset += element.count * PlyStride(element);
+    } else if (element.name == "face" && has_vertices) {
+      auto const kSize = ReadPlyFaces(kData, element, swap, mesh);
+      if (kSize == 0) return false;
+      offset += kSize;
+    } else if (auto const kStride = PlyStride(element); kStride > 0) {
+      offset += element.count * kStride;
+    } else {
+      for (uint64_t i = 0; i < element.count; ++i) {
+        auto const kSize =
+            PlyRecordSize(kBytes.subspan(offset), element, swap);
+        if (!kSize) return false;
+        offset += *kSize;
+      }
+    }
+    if (offset > kBytes.size()) return false;
+  }
+  return !mesh.vertex_index.empty();
+}
+}  // namespace cherry
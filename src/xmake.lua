@@ -17,7 +17,7 @@ target("Cherry")
     add_includedirs("$(curdir)/include")
 
     add_files("$(curdir)/src/**.cc")
-    remove_files("$(curdir)/src/object/mesh.cc", "$(curdir)/src/utility/sampler.cc")
+    remove_files("$(curdir)/src/utility/sampler.cc")
 
     add_packages("fmt", "openmp", "json", "magic_enum", "cli11")
 target_end()